@@ -3,10 +3,14 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -32,6 +36,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +52,46 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus master IDE port addresses, relative to the channel's
+   bus master base (PCI BAR4, plus 8 for the secondary channel). */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRDT address. */
+
+/* Bus master command register bits. */
+#define BM_CMD_START 0x01       /* Start/stop bus master transfer. */
+#define BM_CMD_READ 0x08        /* 1=write to memory (disk read). */
+
+/* Bus master status register bits. */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+#define BM_STA_INTR 0x04        /* Interrupt (write 1 to clear). */
+
+/* PCI configuration space access, mechanism #1. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* A physical region descriptor: one contiguous piece of a DMA
+   transfer.  A region may not cross a 64 kB boundary. */
+struct prd {
+	uint32_t addr;              /* Physical base address. */
+	uint16_t size;              /* Byte count, 0 means 64 kB. */
+	uint16_t flags;             /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000          /* End of table. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))
+
+/* Largest DRQ block we ask for with SET MULTIPLE MODE: one page. */
+#define MULTIPLE_MAX 8
+
+/* Most queued requests merged into a single ATA command. */
+#define MERGE_MAX 16
 
 /* An ATA device. */
 struct disk {
@@ -55,7 +100,10 @@ struct disk {
 	int dev_no;                 /* Device 0 or 1 for master or slave. */
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
+	bool dma;                   /* 1=Device supports DMA transfers. */
 	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+	int multiple;               /* Sectors per DRQ block with READ/WRITE
+								   MULTIPLE, or 1 if unsupported. */
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
@@ -68,11 +116,21 @@ struct channel {
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
 
-	struct lock lock;           /* Must acquire to access the controller. */
+	struct lock lock;           /* Protects queue and head. */
+	struct condition queue_ready;   /* Signaled when queue becomes nonempty. */
+	struct list queue;          /* Pending disk_requests, ordered by
+								   (device, sector). */
+	disk_sector_t head;         /* Sector following the last transfer, for
+								   C-LOOK ordering. */
+	int head_dev;               /* Device of the last transfer. */
+
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	uint16_t bm_base;           /* Bus master base port, 0 if no DMA. */
+	struct prd *prdt;           /* Physical region descriptor table. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
@@ -84,7 +142,30 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void set_multiple_mode (struct disk *, const uint16_t *id);
+static uint16_t find_bus_master (void);
+
+/* Requests merged into one ATA command: REQ_CNT requests on
+   disk D covering CNT consecutive sectors from SECTOR. */
+struct batch {
+	struct disk *d;
+	disk_sector_t sector;
+	size_t cnt;
+	bool write;
+	struct disk_request *reqs[MERGE_MAX];
+	size_t req_cnt;
+};
+
+static void disk_worker (void *channel_);
+static void next_batch (struct channel *, struct batch *);
+static void sync_transfer (struct disk *, disk_sector_t, void *, size_t cnt,
+		bool write);
+
+static void pio_read (struct batch *);
+static void pio_write (struct batch *);
+static bool dma_transfer (struct batch *);
+
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -99,6 +180,7 @@ static void interrupt_handler (struct intr_frame *);
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) {
+	uint16_t bm_base = find_bus_master ();
 	size_t chan_no;
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
@@ -120,9 +202,23 @@ disk_init (void) {
 				NOT_REACHED ();
 		}
 		lock_init (&c->lock);
+		cond_init (&c->queue_ready);
+		list_init (&c->queue);
+		c->head = 0;
+		c->head_dev = 0;
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
 
+		/* Use bus master DMA if the controller offers it,
+		   otherwise fall back to PIO. */
+		c->bm_base = 0;
+		c->prdt = NULL;
+		if (bm_base != 0) {
+			c->prdt = palloc_get_page (0);
+			if (c->prdt != NULL)
+				c->bm_base = bm_base + chan_no * 8;
+		}
+
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = &c->devices[dev_no];
@@ -131,7 +227,9 @@ disk_init (void) {
 			d->dev_no = dev_no;
 
 			d->is_ata = false;
+			d->dma = false;
 			d->capacity = 0;
+			d->multiple = 1;
 
 			d->read_cnt = d->write_cnt = 0;
 		}
@@ -150,6 +248,10 @@ disk_init (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device (&c->devices[dev_no]);
+
+		/* From here on only the channel's worker thread touches
+		   the controller. */
+		thread_create (c->name, PRI_MAX, disk_worker, c);
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
@@ -209,21 +311,7 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -233,23 +321,334 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
    per-disk locking is unneeded. */
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	struct channel *c;
+	disk_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  Returns once the data has arrived.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+		size_t cnt) {
+	sync_transfer (d, sec_no, buffer, cnt, false);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving all of the
+   data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+		const void *buffer, size_t cnt) {
+	sync_transfer (d, sec_no, (void *) buffer, cnt, true);
+}
 
+/* Initializes REQ to move CNT sectors (at most DISK_XFER_MAX)
+   starting at SEC_NO between disk D and BUFFER: from BUFFER to
+   the disk if WRITE, the other way otherwise.  Once the transfer
+   is complete, DONE is called with REQ from the channel's worker
+   thread.  AUX is left for DONE's use. */
+void
+disk_request_init (struct disk_request *req, struct disk *d,
+		disk_sector_t sec_no, void *buffer, size_t cnt, bool write,
+		disk_done_func *done, void *aux) {
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
+	ASSERT (cnt > 0 && cnt <= DISK_XFER_MAX);
+	ASSERT (is_kernel_vaddr (buffer));
+
+	req->disk = d;
+	req->sector = sec_no;
+	req->buffer = buffer;
+	req->cnt = cnt;
+	req->write = write;
+	req->done = done;
+	req->aux = aux;
+}
+
+/* Queues REQ on its disk's channel and returns at once.  REQ and
+   its buffer must stay valid until REQ's completion function has
+   been called. */
+void
+disk_submit (struct disk_request *req) {
+	struct channel *c = req->disk->channel;
+	struct list_elem *e;
+
+	ASSERT (req->sector + req->cnt <= req->disk->capacity);
 
-	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (r->disk->dev_no > req->disk->dev_no
+				|| (r->disk == req->disk && r->sector > req->sector))
+			break;
+	}
+	list_insert (e, &req->elem);
+	cond_signal (&c->queue_ready, &c->lock);
 	lock_release (&c->lock);
 }
-
+
+/* Completion function for sync_transfer(). */
+static void
+sync_done (struct disk_request *req) {
+	sema_up (req->aux);
+}
+
+/* Moves CNT sectors starting at SEC_NO between disk D and BUFFER
+   through the request queue and waits for the transfer to
+   finish.  User buffers are staged through a kernel page, since
+   the worker thread runs in its own address space; copying in
+   the caller's context also keeps page faults on them working. */
+static void
+sync_transfer (struct disk *d, disk_sector_t sec_no, void *buffer_,
+		size_t cnt, bool write) {
+	uint8_t *buffer = buffer_;
+	uint8_t *bounce = NULL;
+	size_t max = DISK_XFER_MAX;
+	struct semaphore done;
+
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	if (!is_kernel_vaddr (buffer)) {
+		bounce = palloc_get_page (0);
+		if (bounce == NULL)
+			PANIC ("%s: no memory for bounce buffer", d->name);
+		max = PGSIZE / DISK_SECTOR_SIZE;
+	}
+
+	sema_init (&done, 0);
+	while (cnt > 0) {
+		size_t xfer = cnt < max ? cnt : max;
+		struct disk_request req;
+
+		if (bounce != NULL && write)
+			memcpy (bounce, buffer, xfer * DISK_SECTOR_SIZE);
+		disk_request_init (&req, d, sec_no, bounce != NULL ? bounce : buffer,
+				xfer, write, sync_done, &done);
+		disk_submit (&req);
+		sema_down (&done);
+		if (bounce != NULL && !write)
+			memcpy (buffer, bounce, xfer * DISK_SECTOR_SIZE);
+
+		buffer += xfer * DISK_SECTOR_SIZE;
+		sec_no += xfer;
+		cnt -= xfer;
+	}
+	palloc_free_page (bounce);
+}
+
+/* Worker thread for channel CHANNEL_.  Takes batches of merged
+   requests off the channel's queue in C-LOOK order, carries them
+   out by DMA or PIO, and calls each request's completion
+   function.  One worker per channel lets both channels transfer
+   at the same time. */
+static void
+disk_worker (void *channel_) {
+	struct channel *c = channel_;
+
+	for (;;) {
+		struct batch b;
+		size_t i;
+
+		lock_acquire (&c->lock);
+		while (list_empty (&c->queue))
+			cond_wait (&c->queue_ready, &c->lock);
+		next_batch (c, &b);
+		lock_release (&c->lock);
+
+		if (!dma_transfer (&b)) {
+			if (b.write)
+				pio_write (&b);
+			else
+				pio_read (&b);
+		}
+		if (b.write)
+			b.d->write_cnt += b.cnt;
+		else
+			b.d->read_cnt += b.cnt;
+
+		for (i = 0; i < b.req_cnt; i++)
+			b.reqs[i]->done (b.reqs[i]);
+	}
+}
+
+/* Removes the next batch from C's queue into B.  Following
+   C-LOOK, picks the first request at or past the head position
+   in (device, sector) order, wrapping around to the lowest one,
+   then merges the following requests that continue it on the
+   same disk in the same direction.  C's lock must be held and
+   its queue must not be empty. */
+static void
+next_batch (struct channel *c, struct batch *b) {
+	struct list_elem *e;
+	struct disk_request *r;
+
+	ASSERT (!list_empty (&c->queue));
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		r = list_entry (e, struct disk_request, elem);
+		if (r->disk->dev_no > c->head_dev
+				|| (r->disk->dev_no == c->head_dev && r->sector >= c->head))
+			break;
+	}
+	if (e == list_end (&c->queue))
+		e = list_begin (&c->queue);
+
+	r = list_entry (e, struct disk_request, elem);
+	b->d = r->disk;
+	b->sector = r->sector;
+	b->cnt = 0;
+	b->write = r->write;
+	b->req_cnt = 0;
+	while (e != list_end (&c->queue) && b->req_cnt < MERGE_MAX) {
+		r = list_entry (e, struct disk_request, elem);
+		if (r->disk != b->d || r->write != b->write
+				|| r->sector != b->sector + b->cnt
+				|| b->cnt + r->cnt > DISK_XFER_MAX)
+			break;
+		e = list_remove (e);
+		b->reqs[b->req_cnt++] = r;
+		b->cnt += r->cnt;
+	}
+
+	c->head = b->sector + b->cnt;
+	c->head_dev = b->d->dev_no;
+}
+
+/* Returns the buffer for the I'th sector of batch B. */
+static uint8_t *
+batch_sector (const struct batch *b, size_t i) {
+	size_t r;
+
+	for (r = 0; i >= b->reqs[r]->cnt; r++)
+		i -= b->reqs[r]->cnt;
+	return (uint8_t *) b->reqs[r]->buffer + i * DISK_SECTOR_SIZE;
+}
+
+/* Reads batch B from its disk in PIO mode.  If the disk supports
+   READ MULTIPLE, raises one interrupt per D->multiple sectors
+   instead of one per sector. */
+static void
+pio_read (struct batch *b) {
+	struct disk *d = b->d;
+	struct channel *c = d->channel;
+	bool multiple = d->multiple > 1 && b->cnt > 1;
+	size_t i;
+
+	select_sector (d, b->sector, b->cnt);
+	issue_pio_command (c, multiple ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+	for (i = 0; i < b->cnt; ) {
+		size_t block = multiple ? (size_t) d->multiple : 1;
+		if (block > b->cnt - i)
+			block = b->cnt - i;
+
+		sema_down (&c->completion_wait);
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk read failed, sector=%"PRDSNu,
+					d->name, b->sector + (disk_sector_t) i);
+		for (; block > 0; block--, i++)
+			input_sector (c, batch_sector (b, i));
+	}
+}
+
+/* Writes batch B to its disk in PIO mode, using WRITE MULTIPLE
+   if the disk supports it. */
+static void
+pio_write (struct batch *b) {
+	struct disk *d = b->d;
+	struct channel *c = d->channel;
+	bool multiple = d->multiple > 1 && b->cnt > 1;
+	size_t i;
+
+	select_sector (d, b->sector, b->cnt);
+	issue_pio_command (c, multiple ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+	for (i = 0; i < b->cnt; ) {
+		size_t block = multiple ? (size_t) d->multiple : 1;
+		if (block > b->cnt - i)
+			block = b->cnt - i;
+
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk write failed, sector=%"PRDSNu,
+					d->name, b->sector + (disk_sector_t) i);
+		for (; block > 0; block--, i++)
+			output_sector (c, batch_sector (b, i));
+		sema_down (&c->completion_wait);
+	}
+}
+
+/* Carries out batch B with bus master DMA, scattering or
+   gathering across the buffers of its requests.  The CPU is free
+   to run other threads until the single completion interrupt
+   arrives.
+   Returns false without touching the disk if DMA cannot be used
+   for this batch, in which case the caller should use PIO.
+   Request buffers are kernel addresses, which map physical
+   memory linearly, so each one is physically contiguous. */
+static bool
+dma_transfer (struct batch *b) {
+	struct disk *d = b->d;
+	struct channel *c = d->channel;
+	bool read = !b->write;
+	uint8_t bm_status;
+	size_t i, r;
+
+	if (c->bm_base == 0 || !d->dma)
+		return false;
+
+	/* Build the PRD table, splitting each buffer at 64 kB
+	   boundaries. */
+	for (i = r = 0; r < b->req_cnt; r++) {
+		const void *buffer = b->reqs[r]->buffer;
+		size_t size = b->reqs[r]->cnt * DISK_SECTOR_SIZE;
+		uint64_t paddr = vtop (buffer);
+
+		if ((uint64_t) buffer % 2 != 0 || paddr + size > 0x100000000ULL)
+			return false;
+		while (size > 0) {
+			size_t chunk = 0x10000 - (paddr & 0xffff);
+			if (chunk > size)
+				chunk = size;
+
+			ASSERT (i < PRD_CNT);
+			c->prdt[i].addr = paddr;
+			c->prdt[i].size = chunk & 0xffff;
+			c->prdt[i].flags = 0;
+			paddr += chunk;
+			size -= chunk;
+			i++;
+		}
+	}
+	c->prdt[i - 1].flags = PRD_EOT;
+
+	/* Point the controller at the table, set the direction and
+	   clear stale interrupt and error bits. */
+	outl (reg_bm_prdt (c), vtop (c->prdt));
+	outb (reg_bm_command (c), read ? BM_CMD_READ : 0);
+	outb (reg_bm_status (c),
+			inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+
+	select_sector (d, b->sector, b->cnt);
+	issue_pio_command (c, read ? CMD_READ_DMA : CMD_WRITE_DMA);
+	outb (reg_bm_command (c), (read ? BM_CMD_READ : 0) | BM_CMD_START);
+	sema_down (&c->completion_wait);
+
+	/* Stop the engine and check for errors. */
+	outb (reg_bm_command (c), read ? BM_CMD_READ : 0);
+	bm_status = inb (reg_bm_status (c));
+	outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_INTR);
+	if ((bm_status & BM_STA_ERR) || (inb (reg_alt_status (c)) & STA_ERR))
+		PANIC ("%s: disk DMA %s failed, sector=%"PRDSNu,
+				d->name, read ? "read" : "write", b->sector);
+	return true;
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -364,6 +763,12 @@ identify_ata_device (struct disk *d) {
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+	/* Enable READ/WRITE MULTIPLE if the disk supports it. */
+	set_multiple_mode (d, id);
+
+	/* Word 49 bit 8: DMA supported. */
+	d->dma = (id[49] & (1 << 8)) != 0;
+
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -382,6 +787,84 @@ identify_ata_device (struct disk *d) {
 	printf ("\"\n");
 }
 
+/* Issues SET MULTIPLE MODE to disk D, whose IDENTIFY DEVICE
+   response is ID, so that READ/WRITE MULTIPLE transfer up to
+   MULTIPLE_MAX sectors per interrupt.  Leaves D->multiple at 1
+   if the disk does not support it or rejects the command. */
+static void
+set_multiple_mode (struct disk *d, const uint16_t *id) {
+	struct channel *c = d->channel;
+	int max = id[47] & 0xff;
+	int multiple;
+
+	/* Largest power of two the disk accepts, capped at MULTIPLE_MAX. */
+	for (multiple = MULTIPLE_MAX; multiple > max; multiple /= 2)
+		continue;
+	if (multiple < 2)
+		return;
+
+	select_device_wait (d);
+	outb (reg_nsect (c), multiple);
+	issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	if ((inb (reg_status (c)) & STA_ERR) == 0)
+		d->multiple = multiple;
+}
+
+/* Reads the 32-bit register at offset REG of PCI function
+   BUS:DEV.FN from configuration space. */
+static uint32_t
+pci_read_config (int bus, int dev, int fn, int reg) {
+	outl (PCI_CONFIG_ADDR, 0x80000000 | (bus << 16) | (dev << 11)
+			| (fn << 8) | (reg & 0xfc));
+	return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes DATA to the 32-bit register at offset REG of PCI
+   function BUS:DEV.FN. */
+static void
+pci_write_config (int bus, int dev, int fn, int reg, uint32_t data) {
+	outl (PCI_CONFIG_ADDR, 0x80000000 | (bus << 16) | (dev << 11)
+			| (fn << 8) | (reg & 0xfc));
+	outl (PCI_CONFIG_DATA, data);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that advertises bus
+   mastering, such as the PIIX in a standard PC, and enables bus
+   mastering on it.  Returns the I/O base of its bus master
+   registers, or 0 if there is none and disks must use PIO. */
+static uint16_t
+find_bus_master (void) {
+	int dev, fn;
+
+	for (dev = 0; dev < 32; dev++)
+		for (fn = 0; fn < 8; fn++) {
+			uint32_t id = pci_read_config (0, dev, fn, 0x00);
+			uint32_t class = pci_read_config (0, dev, fn, 0x08);
+			uint32_t bar4;
+
+			if ((id & 0xffff) == 0xffff)
+				continue;
+
+			/* Class 01h (mass storage), subclass 01h (IDE),
+			   programming interface bit 7 (bus master capable). */
+			if ((class >> 16) != 0x0101 || !(class & 0x8000))
+				continue;
+
+			/* BAR4 must be an assigned I/O space region. */
+			bar4 = pci_read_config (0, dev, fn, 0x20);
+			if (!(bar4 & 1) || (bar4 & 0xfffc) == 0)
+				continue;
+
+			/* Enable I/O space and bus mastering. */
+			pci_write_config (0, dev, fn, 0x04,
+					pci_read_config (0, dev, fn, 0x04) | 0x05);
+			return bar4 & 0xfffc;
+		}
+	return 0;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -402,17 +885,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the transfer length CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
+	ASSERT (cnt > 0 && cnt <= DISK_XFER_MAX);
 	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
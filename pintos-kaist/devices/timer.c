@@ -17,9 +17,26 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, and the counter value for one timer
+   tick, rounded to nearest. */
+#define PIT_HZ 1193180
+#define PIT_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot interval, in ticks, that fits the 8254's
+   16-bit counter. */
+#define ONESHOT_MAX_TICKS (0xffff / PIT_COUNT)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* While the CPU is idle, the timer runs in one-shot mode instead
+   of interrupting every tick; see timer_idle_enter().  This is
+   the number of ticks that will have passed when the pending
+   one-shot interrupt arrives, or 0 in periodic mode.  It is 1
+   once timer_idle_exit() has caught up and only the interrupt at
+   the next tick boundary is left. */
+static int64_t oneshot_ticks;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -28,20 +45,19 @@ static intr_handler_func timer_interrupt;
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
+static void timer_advance(int64_t n);
+static void pit_periodic(void);
+static void pit_oneshot(uint16_t count);
+static uint16_t pit_read_count(void);
+static bool pit_out_high(void);
+static bool pic_irq0_pending(void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void timer_init(void)
 {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb(0x40, count & 0xff);
-	outb(0x40, count >> 8);
-
+	pit_periodic();
 	intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -125,15 +141,168 @@ void timer_print_stats(void)
 	printf("Timer: %" PRId64 " ticks\n", timer_ticks());
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  Nothing can become runnable until an interrupt
+   arrives, so instead of waking up every tick, programs the timer
+   to interrupt once when the earliest sleeping thread is due (or
+   after ONESHOT_MAX_TICKS, if that is sooner).  The interrupt
+   still lands on a tick boundary, so the tick grid is kept.
+
+   The 8254's 16-bit counter limits a one-shot to
+   ONESHOT_MAX_TICKS, so even with no sleepers the idle CPU still
+   wakes up every few ticks; idling longer would need a wider
+   timer such as the local APIC's. */
+void timer_idle_enter(void)
+{
+	int64_t n;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (oneshot_ticks != 0)
+		return;
+
+	/* A tick that ended after interrupts were turned off is still
+	   latched in the PIC and not yet counted in TICKS.  Arming the
+	   one-shot now would make its handler credit N ticks for it, so
+	   take it in periodic mode first. */
+	if (pic_irq0_pending())
+		return;
+
+	n = thread_next_wakeup() - ticks;
+	if (n <= 1)
+		return;
+	if (n > ONESHOT_MAX_TICKS)
+		n = ONESHOT_MAX_TICKS;
+
+	/* Finish the current period, then N - 1 whole ones. */
+	pit_oneshot(pit_read_count() + (n - 1) * PIT_COUNT);
+	oneshot_ticks = n;
+
+	/* The period may have ended between the check above and
+	   reprogramming the counter.  The one-shot cannot fire that
+	   soon, so a latched interrupt belongs to that tick: go back to
+	   periodic mode so that it counts as one.  This moves the tick
+	   grid by the few microseconds since the boundary. */
+	if (pic_irq0_pending())
+	{
+		pit_periodic();
+		oneshot_ticks = 0;
+	}
+}
+
+/* Called by intr_handler() at the start of every external
+   interrupt other than the timer's, with interrupts off.  If the
+   interrupt woke the CPU out of timer_idle_enter()'s halt,
+   accounts for the ticks that have passed so far, before the
+   handler runs and possibly wakes a thread, and arranges for the
+   next interrupt to arrive at the next tick boundary, where the
+   timer goes back to periodic mode. */
+void timer_idle_exit(void)
+{
+	int64_t remaining, elapsed, whole;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (oneshot_ticks <= 1)
+		return;
+
+	/* Past terminal count, the counter wraps around, so the value
+	   is only good if the output was still low after reading it.
+	   Otherwise the one-shot interrupt is pending and will do the
+	   accounting. */
+	remaining = pit_read_count();
+	if (pit_out_high())
+		return;
+
+	elapsed = oneshot_ticks * PIT_COUNT - remaining;
+	whole = elapsed / PIT_COUNT;
+	pit_oneshot(PIT_COUNT - elapsed % PIT_COUNT);
+	oneshot_ticks = 1;
+	timer_advance(whole);
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt(struct intr_frame *args UNUSED)
 {
-	ticks++;
-	thread_tick();
+	int64_t n = 1;
+
+	if (oneshot_ticks != 0)
+	{
+		n = oneshot_ticks;
+		oneshot_ticks = 0;
+		pit_periodic();
+	}
+	timer_advance(n);
+}
+
+/* Advances the tick count by N ticks, running the scheduler's
+   per-tick work for each and then waking up sleepers that are
+   due.  Interrupts must be off. */
+static void
+timer_advance(int64_t n)
+{
+	if (n <= 0)
+		return;
+	while (n-- > 0)
+	{
+		ticks++;
+		thread_tick();
+	}
 	thread_wakeup(ticks);
 }
 
+/* Programs 8254 counter 0 to interrupt every PIT_COUNT input
+   clocks, that is, TIMER_FREQ times per second. */
+static void
+pit_periodic(void)
+{
+	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb(0x40, PIT_COUNT & 0xff);
+	outb(0x40, PIT_COUNT >> 8);
+}
+
+/* Programs 8254 counter 0 to interrupt once, COUNT input clocks
+   from now. */
+static void
+pit_oneshot(uint16_t count)
+{
+	outb(0x43, 0x30); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb(0x40, count & 0xff);
+	outb(0x40, count >> 8);
+}
+
+/* Returns the current value of 8254 counter 0. */
+static uint16_t
+pit_read_count(void)
+{
+	uint8_t lo, hi;
+
+	outb(0x43, 0x00); /* Counter latch command for counter 0. */
+	lo = inb(0x40);
+	hi = inb(0x40);
+	return lo | (hi << 8);
+}
+
+/* Returns true if counter 0's output is high, which in one-shot
+   mode means that it has reached terminal count. */
+static bool
+pit_out_high(void)
+{
+	outb(0x43, 0xe2); /* Read-back: status only, counter 0. */
+	return (inb(0x40) & 0x80) != 0;
+}
+
+/* Returns true if the timer's interrupt, IRQ0, has been raised
+   but not yet delivered, as with interrupts off.  Reads the
+   master PIC's interrupt request register. */
+static bool
+pic_irq0_pending(void)
+{
+	outb(0x20, 0x0a); /* OCW3: read IRR on next read of port 0x20. */
+	return (inb(0x20) & 0x01) != 0;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -8,6 +8,7 @@ struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	struct readahead ra;        /* Sequential read-ahead state. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -20,6 +21,7 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		inode_readahead_init (&file->ra);
 		return file;
 	} else {
 		inode_close (inode);
@@ -72,6 +74,7 @@ file_get_inode (struct file *file) {
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	inode_readahead (file->inode, &file->ra, bytes_read, file->pos);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -83,7 +86,9 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-	return inode_read_at (file->inode, buffer, size, file_ofs);
+	off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+	inode_readahead (file->inode, &file->ra, bytes_read, file_ofs);
+	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
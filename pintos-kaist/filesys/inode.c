@@ -5,7 +5,10 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/page_cache.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -19,6 +22,10 @@ struct inode_disk {
 	uint32_t unused[125];               /* Not used. */
 };
 
+/* Bounds of the adaptive read-ahead window, in sectors. */
+#define READAHEAD_MIN 4
+#define READAHEAD_MAX 16
+
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
 static inline size_t
@@ -33,6 +40,8 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rw;                   /* Read side: data I/O.
+	                                       Write side: deny/remove. */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -53,10 +62,22 @@ byte_to_sector (const struct inode *inode, off_t pos) {
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes.  Opening an inode that is already open,
+ * which path lookups do all the time, only takes the read side;
+ * adding or removing an inode takes the write side.  An inode's
+ * open_cnt is changed with interrupts off, and drops to 0 only
+ * under the write side, so that a reader never finds an inode
+ * that is being freed. */
+static struct rwlock open_inodes_lock;
+
+static struct inode *open_inodes_lookup (disk_sector_t);
+static int open_cnt_add (struct inode *, int delta);
+
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -81,13 +102,13 @@ inode_create (disk_sector_t sector, off_t length) {
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
 		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
+			page_cache_write (sector, disk_inode);
 			if (sectors > 0) {
 				static char zeros[DISK_SECTOR_SIZE];
 				size_t i;
 
 				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
+					page_cache_write (disk_inode->start + i, zeros); 
 			}
 			success = true; 
 		} 
@@ -101,39 +122,78 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
 	struct inode *inode;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	rwlock_acquire_read (&open_inodes_lock);
+	inode = open_inodes_lookup (sector);
+	rwlock_release_read (&open_inodes_lock);
+	if (inode != NULL)
+		return inode;
+
+	/* Check again, since another thread may have opened it after
+	 * we dropped the read side. */
+	rwlock_acquire_write (&open_inodes_lock);
+	inode = open_inodes_lookup (sector);
+	if (inode != NULL) {
+		rwlock_release_write (&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		rwlock_release_write (&open_inodes_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
+	/* Initialize.  Reading the on-disk inode under the lock keeps
+	 * a second opener from seeing it half initialized. */
 	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	rwlock_init (&inode->rw);
+	page_cache_read (inode->sector, &inode->data);
+	rwlock_release_write (&open_inodes_lock);
 	return inode;
 }
 
-/* Reopens and returns INODE. */
+/* Returns the open inode for SECTOR with its open_cnt
+ * incremented, or a null pointer if it is not open.
+ * open_inodes_lock must be held. */
+static struct inode *
+open_inodes_lookup (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector) {
+			open_cnt_add (inode, 1);
+			return inode;
+		}
+	}
+	return NULL;
+}
+
+/* Adds DELTA to INODE's open_cnt atomically and returns the new
+ * count. */
+static int
+open_cnt_add (struct inode *inode, int delta) {
+	enum intr_level old_level = intr_disable ();
+	int cnt = inode->open_cnt += delta;
+	intr_set_level (old_level);
+	return cnt;
+}
+
+/* Reopens and returns INODE.  The caller's own reference keeps
+ * INODE open, so no lock is needed. */
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		open_cnt_add (inode, 1);
 	return inode;
 }
 
@@ -148,14 +208,29 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	enum intr_level old_level;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
+	/* Dropping a reference that is not the last one needs no
+	 * lock. */
+	old_level = intr_disable ();
+	if (inode->open_cnt > 1) {
+		inode->open_cnt--;
+		intr_set_level (old_level);
+		return;
+	}
+	intr_set_level (old_level);
+
+	/* Release resources if this was the last opener.  An opener
+	 * may have found INODE before we got the write side. */
+	rwlock_acquire_write (&open_inodes_lock);
+	if (open_cnt_add (inode, -1) == 0) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
+		rwlock_release_write (&open_inodes_lock);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -165,7 +240,8 @@ inode_close (struct inode *inode) {
 		}
 
 		free (inode); 
-	}
+	} else
+		rwlock_release_write (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -173,7 +249,9 @@ inode_close (struct inode *inode) {
 void
 inode_remove (struct inode *inode) {
 	ASSERT (inode != NULL);
+	rwlock_acquire_write (&inode->rw);
 	inode->removed = true;
+	rwlock_release_write (&inode->rw);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -183,8 +261,13 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
+	/* Readers of the same inode share the lock.  Each sector is
+	 * copied under its cache entry's lock, so a concurrent write
+	 * is seen either entirely or not at all within one sector;
+	 * a read spanning several sectors may still see a write that
+	 * is in progress on some of them. */
+	rwlock_acquire_read (&inode->rw);
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -200,27 +283,16 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		/* Copy the chunk out of the buffer cache. */
+		page_cache_read_at (sector_idx, buffer + bytes_read, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+	rwlock_release_read (&inode->rw);
 
 	return bytes_read;
 }
@@ -235,10 +307,19 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
-	if (inode->deny_write_cnt)
+	/* Writers only take the read side too: files do not grow, so
+	 * they change no metadata.  Each sector is copied in under its
+	 * cache entry's write lock (see page_cache_write_at()), so
+	 * concurrent writes do not interleave within a sector, though
+	 * writes spanning several sectors may interleave sector by
+	 * sector.  The write side is for inode_deny_write(), which thus
+	 * waits out writes in flight. */
+	rwlock_acquire_read (&inode->rw);
+	if (inode->deny_write_cnt) {
+		rwlock_release_read (&inode->rw);
 		return 0;
+	}
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
@@ -255,45 +336,81 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* Copy the chunk into the buffer cache, which reads the
+		 * rest of the sector first if the chunk is partial. */
+		page_cache_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
+	rwlock_release_read (&inode->rw);
 
 	return bytes_written;
 }
 
+/* Initializes read-ahead state RA for a new opener.  A first
+ * read at offset 0 counts as sequential. */
+void
+inode_readahead_init (struct readahead *ra) {
+	ra->next = 0;
+	ra->ahead = 0;
+	ra->window = 0;
+}
+
+/* Updates RA after its opener has read SIZE bytes from INODE at
+ * OFFSET.  While reads keep continuing where the last one ended,
+ * the window doubles from READAHEAD_MIN up to READAHEAD_MAX
+ * sectors and the sectors that far past the read are prefetched
+ * into the buffer cache without waiting for them.  A read
+ * anywhere else closes the window again, so random access does
+ * not pollute the cache. */
+void
+inode_readahead (struct inode *inode, struct readahead *ra, off_t size,
+		off_t offset) {
+	size_t length = bytes_to_sectors (inode_length (inode));
+	size_t first, last;
+
+	if (offset != ra->next) {
+		ra->next = offset + size;
+		ra->ahead = 0;
+		ra->window = 0;
+		return;
+	}
+	ra->next = offset + size;
+	if (size <= 0)
+		return;
+
+	if (ra->window == 0)
+		ra->window = READAHEAD_MIN;
+	else if (ra->window < READAHEAD_MAX)
+		ra->window *= 2;
+
+	/* Skip what an earlier call already prefetched. */
+	first = ra->next / DISK_SECTOR_SIZE;
+	if (first < ra->ahead)
+		first = ra->ahead;
+	last = ra->next / DISK_SECTOR_SIZE + ra->window;
+	if (last > length)
+		last = length;
+
+	for (; first < last; first++)
+		page_cache_readahead (inode->data.start + first);
+	if (last > ra->ahead)
+		ra->ahead = last;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
 inode_deny_write (struct inode *inode) 
 {
+	rwlock_acquire_write (&inode->rw);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release_write (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -301,9 +418,11 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	rwlock_acquire_write (&inode->rw);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release_write (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -1,50 +1,379 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
-#include "vm/vm.h"
-static bool page_cache_readahead (struct page *page, void *kva);
-static bool page_cache_writeback (struct page *page);
-static void page_cache_destroy (struct page *page);
-
-/* DO NOT MODIFY this struct */
-static const struct page_operations page_cache_op = {
-	.swap_in = page_cache_readahead,
-	.swap_out = page_cache_writeback,
-	.destroy = page_cache_destroy,
-	.type = VM_PAGE_CACHE,
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors kept in the cache. */
+#define CACHE_CNT 64
+
+/* The write-behind daemon wakes up this often, and writes back
+ * sectors that have been dirty for at least WRITE_BEHIND_AGE. */
+#define WRITE_BEHIND_INTERVAL TIMER_FREQ
+#define WRITE_BEHIND_AGE (5 * TIMER_FREQ)
+
+/* A cached file system sector. */
+struct cache_entry {
+	disk_sector_t sector;               /* Sector held, if valid. */
+	bool valid;                         /* True if SECTOR is assigned. */
+	bool io;                            /* True while DATA is being read or
+	                                       written back; others must wait. */
+	bool dirty;                         /* True if DATA is newer than disk. */
+	bool accessed;                      /* Second chance for clock. */
+	int pin_cnt;                        /* Users copying DATA right now. */
+	struct rwlock rw;                   /* Held by pinned users while they
+	                                       copy DATA: read side to copy
+	                                       out, write side to copy in. */
+	int64_t dirty_since;                /* Tick when DIRTY was last set
+	                                       from false. */
+	struct disk_request req;            /* Read-ahead request. */
+	uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
 };
 
+static struct cache_entry cache[CACHE_CNT];
+
+/* Protects every entry's bookkeeping and the clock hand.  DATA
+ * of a pinned entry is protected by the entry's RW instead. */
+static struct lock cache_lock;
+
+/* Broadcast whenever an entry's IO flag clears or its pin count
+ * drops to zero. */
+static struct condition cache_changed;
+
+/* Next entry for the clock algorithm to examine. */
+static size_t clock_hand;
+
 tid_t page_cache_workerd;
 
-/* The initializer of file vm */
+static struct cache_entry *cache_get (disk_sector_t, bool need_data);
+static void cache_put (struct cache_entry *, bool dirtied);
+static struct cache_entry *cache_lookup (disk_sector_t);
+static struct cache_entry *cache_evict (void);
+static void cache_write_back (struct cache_entry *);
+static void cache_read_user (disk_sector_t, void *, off_t, size_t);
+static void cache_write_user (disk_sector_t, const void *, off_t, size_t);
+static void readahead_done (struct disk_request *);
+static void page_cache_flush_aged (int64_t age);
+static void page_cache_kworkerd (void *aux);
+
+/* Initializes the buffer cache and starts its write-behind
+ * daemon. */
 void
-pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+page_cache_init (void) {
+	size_t i;
+
+	lock_init (&cache_lock);
+	cond_init (&cache_changed);
+	clock_hand = 0;
+	for (i = 0; i < CACHE_CNT; i++) {
+		cache[i].valid = false;
+		cache[i].io = false;
+		cache[i].dirty = false;
+		cache[i].accessed = false;
+		cache[i].pin_cnt = 0;
+		rwlock_init (&cache[i].rw);
+	}
+
+	page_cache_workerd = thread_create ("page_cache_kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
 }
 
-/* Initialize the page cache */
-bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
-	/* Set up the handler */
-	page->operations = &page_cache_op;
+/* Reads SIZE bytes at offset OFS within file system sector
+ * SECTOR into BUFFER, through the cache.  The copy is atomic
+ * with respect to writes of the same sector. */
+void
+page_cache_read_at (disk_sector_t sector, void *buffer, off_t ofs,
+		size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
 
+	if (is_user_vaddr (buffer)) {
+		cache_read_user (sector, buffer, ofs, size);
+		return;
+	}
+
+	e = cache_get (sector, true);
+	rwlock_acquire_read (&e->rw);
+	memcpy (buffer, e->data + ofs, size);
+	rwlock_release_read (&e->rw);
+	cache_put (e, false);
 }
 
-/* Utilze the Swap in mechanism to implement readhead */
-static bool
-page_cache_readahead (struct page *page, void *kva) {
+/* Writes SIZE bytes from BUFFER at offset OFS within file system
+ * sector SECTOR, through the cache.  The disk is updated later,
+ * by the write-behind daemon, eviction, or page_cache_flush().
+ * A full-sector write does not read the old contents.  The copy
+ * is atomic with respect to other reads and writes of the same
+ * sector. */
+void
+page_cache_write_at (disk_sector_t sector, const void *buffer, off_t ofs,
+		size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	if (is_user_vaddr (buffer)) {
+		cache_write_user (sector, buffer, ofs, size);
+		return;
+	}
+
+	e = cache_get (sector, size < DISK_SECTOR_SIZE);
+	rwlock_acquire_write (&e->rw);
+	memcpy (e->data + ofs, buffer, size);
+	rwlock_release_write (&e->rw);
+	cache_put (e, true);
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
-static bool
-page_cache_writeback (struct page *page) {
+/* page_cache_read_at() into user BUFFER.  Touching BUFFER may
+ * page fault, and the fault may read this very sector or write
+ * it back, so BUFFER is filled from a bounce buffer only after
+ * the entry is unlocked and unpinned. */
+static void
+cache_read_user (disk_sector_t sector, void *buffer, off_t ofs,
+		size_t size) {
+	uint8_t bounce[DISK_SECTOR_SIZE];
+
+	page_cache_read_at (sector, bounce, ofs, size);
+	memcpy (buffer, bounce, size);
 }
 
-/* Destory the page_cache. */
+/* page_cache_write_at() from user BUFFER, which is likewise
+ * copied into a bounce buffer before the entry is locked. */
 static void
-page_cache_destroy (struct page *page) {
+cache_write_user (disk_sector_t sector, const void *buffer, off_t ofs,
+		size_t size) {
+	uint8_t bounce[DISK_SECTOR_SIZE];
+
+	memcpy (bounce, buffer, size);
+	page_cache_write_at (sector, bounce, ofs, size);
+}
+
+/* Reads file system sector SECTOR into BUFFER, which must have
+ * room for DISK_SECTOR_SIZE bytes. */
+void
+page_cache_read (disk_sector_t sector, void *buffer) {
+	page_cache_read_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Writes DISK_SECTOR_SIZE bytes from BUFFER to file system
+ * sector SECTOR. */
+void
+page_cache_write (disk_sector_t sector, const void *buffer) {
+	page_cache_write_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Starts reading file system sector SECTOR into the cache and
+ * returns without waiting for it.  Read-ahead is only a hint: it
+ * does nothing if SECTOR is already cached, and gives up rather
+ * than wait if no clean entry can be reused right away.  The
+ * disk queue merges adjacent read-ahead requests into a single
+ * transfer. */
+void
+page_cache_readahead (disk_sector_t sector) {
+	struct cache_entry *e;
+
+	lock_acquire (&cache_lock);
+	if (cache_lookup (sector) != NULL) {
+		lock_release (&cache_lock);
+		return;
+	}
+	e = cache_evict ();
+	if (e == NULL || e->dirty) {
+		lock_release (&cache_lock);
+		return;
+	}
+	e->sector = sector;
+	e->valid = true;
+	e->io = true;
+	e->accessed = true;
+	lock_release (&cache_lock);
+
+	disk_request_init (&e->req, filesys_disk, sector, e->data, 1, false,
+			readahead_done, e);
+	disk_submit (&e->req);
+}
+
+/* Completion function for page_cache_readahead(), called by the
+ * disk's worker thread. */
+static void
+readahead_done (struct disk_request *req) {
+	struct cache_entry *e = req->aux;
+
+	lock_acquire (&cache_lock);
+	e->io = false;
+	cond_broadcast (&cache_changed, &cache_lock);
+	lock_release (&cache_lock);
+}
+
+/* Writes every dirty sector back to disk. */
+void
+page_cache_flush (void) {
+	page_cache_flush_aged (0);
+}
+
+/* Returns the entry holding SECTOR, pinned so that it is neither
+ * evicted nor reassigned until cache_put().  On a miss, claims a
+ * victim entry and, if NEED_DATA, reads SECTOR from disk into
+ * it; otherwise the caller is about to overwrite all of it and
+ * the entry stays busy until then. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool need_data) {
+	struct cache_entry *e;
+
+	lock_acquire (&cache_lock);
+	for (;;) {
+		e = cache_lookup (sector);
+		if (e != NULL) {
+			if (e->io) {
+				cond_wait (&cache_changed, &cache_lock);
+				continue;
+			}
+			break;
+		}
+
+		e = cache_evict ();
+		if (e == NULL) {
+			/* Every entry is pinned or busy. */
+			cond_wait (&cache_changed, &cache_lock);
+			continue;
+		}
+		if (e->dirty) {
+			/* Write the victim back, then start over, since
+			 * SECTOR may have been brought in meanwhile. */
+			cache_write_back (e);
+			continue;
+		}
+
+		e->sector = sector;
+		e->valid = true;
+		if (need_data) {
+			e->io = true;
+			lock_release (&cache_lock);
+			disk_read (filesys_disk, sector, e->data);
+			lock_acquire (&cache_lock);
+			e->io = false;
+			cond_broadcast (&cache_changed, &cache_lock);
+		} else {
+			/* Hide the stale contents from other users until
+			 * the caller has filled the entry. */
+			e->io = true;
+		}
+		break;
+	}
+	e->pin_cnt++;
+	e->accessed = true;
+	lock_release (&cache_lock);
+	return e;
+}
+
+/* Unpins entry E, obtained from cache_get().  DIRTIED must be
+ * true if its data was modified. */
+static void
+cache_put (struct cache_entry *e, bool dirtied) {
+	lock_acquire (&cache_lock);
+	ASSERT (e->pin_cnt > 0);
+	if (dirtied && !e->dirty) {
+		e->dirty = true;
+		e->dirty_since = timer_ticks ();
+	}
+	e->io = false;
+	if (--e->pin_cnt == 0)
+		cond_broadcast (&cache_changed, &cache_lock);
+	lock_release (&cache_lock);
+}
+
+/* Returns the valid entry for SECTOR, or a null pointer.
+ * cache_lock must be held. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < CACHE_CNT; i++)
+		if (cache[i].valid && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Picks an entry to reuse with the clock algorithm: unused
+ * entries first, then ones not accessed since the hand last
+ * passed.  Pinned and busy entries are skipped.  Returns a null
+ * pointer if every entry is pinned or busy.  The victim may be
+ * dirty.  cache_lock must be held. */
+static struct cache_entry *
+cache_evict (void) {
+	size_t i;
+
+	for (i = 0; i < CACHE_CNT; i++)
+		if (!cache[i].valid && !cache[i].io)
+			return &cache[i];
+
+	for (i = 0; i < 2 * CACHE_CNT; i++) {
+		struct cache_entry *e = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % CACHE_CNT;
+
+		if (e->pin_cnt > 0 || e->io)
+			continue;
+		if (e->accessed)
+			e->accessed = false;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+/* Writes dirty entry E back to disk.  Other users of E wait
+ * until the write completes.  cache_lock must be held; it is
+ * released during the write.  E must not be pinned. */
+static void
+cache_write_back (struct cache_entry *e) {
+	ASSERT (e->dirty && !e->io && e->pin_cnt == 0);
+
+	e->io = true;
+	e->dirty = false;
+	lock_release (&cache_lock);
+	disk_write (filesys_disk, e->sector, e->data);
+	lock_acquire (&cache_lock);
+	e->io = false;
+	cond_broadcast (&cache_changed, &cache_lock);
+}
+
+/* Writes back every dirty, unpinned entry that has been dirty
+ * for at least AGE ticks.  With AGE 0, also waits for pinned
+ * entries, so that all data reaches the disk. */
+static void
+page_cache_flush_aged (int64_t age) {
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < CACHE_CNT; i++) {
+		struct cache_entry *e = &cache[i];
+
+		while (e->dirty && (e->pin_cnt > 0 || e->io)) {
+			if (age > 0)
+				break;
+			cond_wait (&cache_changed, &cache_lock);
+		}
+		if (e->dirty && e->pin_cnt == 0 && !e->io
+				&& timer_elapsed (e->dirty_since) >= age)
+			cache_write_back (e);
+	}
+	lock_release (&cache_lock);
 }
 
-/* Worker thread for page cache */
+/* Worker thread for page cache: periodically writes back sectors
+ * that have stayed dirty for WRITE_BEHIND_AGE, so that a crash
+ * loses little data while sectors that are rewritten often are
+ * not written back after every change. */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (WRITE_BEHIND_INTERVAL);
+		page_cache_flush_aged (WRITE_BEHIND_AGE);
+	}
 }
@@ -2,6 +2,9 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -15,6 +18,26 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Most sectors moved by a single disk request.  The ATA sector
+ * count register is 8 bits wide, where 0 would mean 256. */
+#define DISK_XFER_MAX 255
+
+struct disk_request;
+typedef void disk_done_func (struct disk_request *);
+
+/* An asynchronous transfer, queued on its disk's channel by
+ * disk_submit(). */
+struct disk_request {
+	struct disk *disk;          /* Disk to transfer to or from. */
+	disk_sector_t sector;       /* First sector. */
+	void *buffer;               /* Kernel buffer of CNT sectors. */
+	size_t cnt;                 /* Number of sectors. */
+	bool write;                 /* True to write BUFFER to disk. */
+	disk_done_func *done;       /* Called when the transfer finishes. */
+	void *aux;                  /* For DONE's use. */
+	struct list_elem elem;      /* Channel queue element. */
+};
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -22,6 +45,13 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multiple (struct disk *, disk_sector_t, const void *,
+		size_t cnt);
+
+void disk_request_init (struct disk_request *, struct disk *, disk_sector_t,
+		void *buffer, size_t cnt, bool write, disk_done_func *, void *aux);
+void disk_submit (struct disk_request *);
 
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
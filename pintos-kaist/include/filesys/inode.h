@@ -7,6 +7,15 @@
 
 struct bitmap;
 
+/* Sequential read-ahead state, kept by each opener of an inode. */
+struct readahead {
+	off_t next;                 /* Offset a sequential read starts at. */
+	size_t ahead;               /* File sector index up to which
+	                               read-ahead has been issued. */
+	size_t window;              /* Sectors to read ahead, 0 if the
+	                               access pattern looks random. */
+};
+
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
 struct inode *inode_open (disk_sector_t);
@@ -16,6 +25,9 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+void inode_readahead_init (struct readahead *);
+void inode_readahead (struct inode *, struct readahead *, off_t size,
+		off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
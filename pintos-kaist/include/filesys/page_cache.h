@@ -1,12 +1,18 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
-
-struct page;
-enum vm_type;
+#include <stddef.h>
+#include "devices/disk.h"
+#include "filesys/off_t.h"
 
 struct page_cache {};
 
 void page_cache_init (void);
-bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+void page_cache_read (disk_sector_t, void *buffer);
+void page_cache_write (disk_sector_t, const void *buffer);
+void page_cache_read_at (disk_sector_t, void *buffer, off_t ofs,
+		size_t size);
+void page_cache_write_at (disk_sector_t, const void *buffer, off_t ofs,
+		size_t size);
+void page_cache_readahead (disk_sector_t);
+void page_cache_flush (void);
 #endif
@@ -0,0 +1,64 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue (pairing heap).
+ *
+ * Like the lists in list.h, this heap does not use dynamically
+ * allocated memory.  Each structure that can be in a heap embeds
+ * a struct heap_elem member, and heap_entry() converts a
+ * heap_elem back into the structure that contains it.
+ *
+ * The heap is ordered by a heap_less_func supplied to
+ * heap_init(): heap_min() returns an element that no other
+ * element is less than.  For a max-heap, supply a function that
+ * returns true if A is greater than B.
+ *
+ * heap_insert() and heap_min() take O(1) time.  heap_pop_min()
+ * and heap_remove() take O(lg n) amortized time.  To change the
+ * key of an element that is in a heap, remove it, change the
+ * key, and insert it again. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem {
+	struct heap_elem *child;    /* First child. */
+	struct heap_elem *next;     /* Next sibling. */
+	struct heap_elem *prev;     /* Previous sibling, or parent if
+	                               this is a first child. */
+};
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap {
+	struct heap_elem *root;     /* Minimum element, or null. */
+	heap_less_func *less;       /* Comparison function. */
+	void *aux;                  /* Auxiliary data for LESS. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+		- offsetof (STRUCT, MEMBER.child)))
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_insert (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop_min (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+
+struct heap_elem *heap_min (struct heap *);
+bool heap_empty (struct heap *);
+
+#endif /* lib/kernel/heap.h */
@@ -22,13 +22,14 @@ static inline int fixed_to_int(fixed_t x){
 }
 
 //14번째 비트값 변동으로 반올림 구현
+//음수는 >>가 내림이 되므로 0 방향으로 버리는 나눗셈을 사용
 static inline int fixed_to_int_round(fixed_t x){
     int a;
     if(x >= 0)
         a = x + (F>>1); // x + 0.5 
     else   
         a = x - (F>>1); // x - 0.5 
-    return a >> SHIFT;
+    return a / F;
 }
 
 // 연산 함수
@@ -0,0 +1,20 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+struct thread;
+
+/* If false (default), a thread's FPU/SIMD registers are loaded on
+ * its first FPU instruction after a context switch, through the
+ * #NM exception.  If true, they are saved and restored on every
+ * context switch.  Controlled by kernel command-line option
+ * "-fpu-eager". */
+extern bool fpu_eager;
+
+void fpu_init (void);
+void fpu_switch (struct thread *curr, struct thread *next);
+void fpu_release (struct thread *);
+bool fpu_copy (struct thread *dst, struct thread *src);
+
+#endif /* threads/fpu.h */
@@ -0,0 +1,25 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#include <stdint.h>
+
+/* switch_threads()'s stack frame: the callee-saved registers,
+ * pushed in order from RBP down to R15, and the return address. */
+struct switch_threads_frame {
+	uint64_t r15;
+	uint64_t r14;
+	uint64_t r13;
+	uint64_t r12;
+	uint64_t rbx;
+	uint64_t rbp;
+	void (*rip) (void);
+};
+
+/* Switches from the running thread to another one.  Pushes the
+ * callee-saved registers on the running thread's stack, stores
+ * its stack pointer into *CUR_RSP, then loads NEXT_RSP, pops the
+ * next thread's callee-saved registers and returns on its stack.
+ * Interrupts must be off. */
+void switch_threads (uint64_t *cur_rsp, uint64_t next_rsp);
+
+#endif /* threads/switch.h */
@@ -1,14 +1,18 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
 
+struct thread;
+
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
 
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, highest priority
+	                               first, then first come. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -17,12 +21,13 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
-bool cmp_sema_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
-
 /* Lock. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	int priority;               /* Highest priority among waiters, or
+	                               PRI_MIN - 1; donated to HOLDER. */
+	struct heap_elem holder_elem; /* Element in HOLDER's held_locks. */
 };
 
 void lock_init (struct lock *);
@@ -30,10 +35,13 @@ void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+bool cmp_lock_priority (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, highest priority
+	                               first, then first come. */
 };
 
 void cond_init (struct condition *);
@@ -41,6 +49,26 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+void waiter_set_priority (struct thread *, int priority);
+void update_priority_for_donations (struct thread *);
+
+/* Readers-writer lock. */
+struct rwlock {
+	int readers;                /* Number of threads reading. */
+	struct thread *writer;      /* Thread writing, or NULL. */
+	struct semaphore read_wait; /* Readers waiting; only the waiters
+	                               are used, the value stays 0. */
+	struct semaphore write_wait; /* Writers waiting, likewise. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+
 
 
 void donation_priority(struct thread *t);
@@ -2,8 +2,10 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #ifdef VM
@@ -29,6 +31,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63	   /* Highest priority. */
 
+/* Thread niceness, for the 4.4BSD scheduler. */
+#define NICE_MIN -20	/* Nicest. */
+#define NICE_DEFAULT 0	/* Default niceness. */
+#define NICE_MAX 20		/* Least nice. */
+
 #define FDT_COUNT 128
 #define FDT_PAGE_COUNT 3
 
@@ -97,14 +104,26 @@ struct thread
 	char name[16];			   /* Name (for debugging purposes). */
 	int priority;			   /* Priority. */
 	int64_t wakeup_ticks;	   // 깨어날 tick
+	struct heap_elem sleep_elem; /* Sleep queue element. */
+	struct list_elem all_elem;	 /* List element for all threads list. */
+
+	/* 4.4BSD scheduler (thread_mlfqs). */
+	int nice;			/* Niceness, NICE_MIN to NICE_MAX. */
+	fixed_t recent_cpu; /* Recent CPU time received. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem; /* List element. */
 
-	int init_priority;
-	struct lock *wait_on_lock;
-	struct list donations;
-	struct list_elem donation_elem;
+	/* Shared between thread.c and synch.c, for priority donation. */
+	int init_priority;				/* Priority before donations. */
+	struct lock *wait_on_lock;		/* Lock being waited for, or NULL. */
+	struct heap held_locks;			/* Locks held, by donated priority. */
+	struct semaphore *wait_on_sema; /* Semaphore being waited on, or NULL. */
+	struct heap_elem wait_elem;		/* Element in wait_on_sema's waiters. */
+	uint64_t wait_seq;				/* Order of arrival in wait_on_sema. */
+	struct condition *wait_on_cond; /* Condition being waited on, or NULL. */
+	struct heap_elem *cond_elem;	/* Element in wait_on_cond's waiters. */
+	int read_locks;					/* Number of rwlocks held for reading. */
 
 	struct intr_frame parent_if;
 	uint64_t user_rsp;
@@ -130,8 +149,12 @@ struct thread
 	struct supplemental_page_table spt;
 #endif
 
+	/* Owned by threads/fpu.c. */
+	void *fpu; /* FPU/SIMD save area, or null before first use. */
+
 	/* Owned by thread.c. */
-	struct intr_frame tf; /* Information for switching */
+	uint64_t switch_rsp;  /* Saved stack pointer, for switch_threads(). */
+	struct intr_frame tf; /* Initial context of a new thread. */
 	unsigned magic;		  /* Detects stack overflow. */
 };
 
@@ -159,21 +182,18 @@ tid_t thread_tid(void);
 const char *thread_name(void);
 
 void thread_exit(void) NO_RETURN;
+
+struct file **thread_fdt_alloc(void);
+void thread_fdt_free(struct file **);
 void thread_yield(void);
 void thread_sleep(int64_t ticks);
 void thread_wakeup(int64_t current_ticks);
-bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux);
+int64_t thread_next_wakeup(void);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
-bool cmp_thread_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
-bool cmp_sema_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 void preempt_priority(void);
-
-bool cmp_donation_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
-void donate_priority(void);
-void remove_donor(struct lock *lock);
-void update_priority_for_donations(void);
+void thread_set_effective_priority(struct thread *t, int priority);
 
 int thread_get_nice(void);
 void thread_set_nice(int);
@@ -182,7 +202,4 @@ int thread_get_load_avg(void);
 
 void do_iret(struct intr_frame *tf);
 
-bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux);
-bool cmp_thread_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
-
 #endif /* threads/thread.h */
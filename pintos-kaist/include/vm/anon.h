@@ -12,14 +12,15 @@ struct anon_page {
     struct swap_slot *slot;
 };
 
+/* 사용 중인 스왑 슬롯. 빈 슬롯은 anon.c의 비트맵으로만 관리됨 */
 struct swap_slot
 {
     disk_sector_t start_sector;
-    struct list page_list;
-    struct list_elem slot_elem;
+    struct list page_list;  /* 이 슬롯을 공유하는 (스왑 아웃된) 페이지들 */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_share_page (struct page *child, struct page *parent);
 
 #endif
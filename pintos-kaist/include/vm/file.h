@@ -14,6 +14,7 @@ struct file_page
 	int read_bytes;
 	int zero_bytes;
 	struct list *file_list;
+	bool mmap; /* VM_MMAP으로 할당된 페이지 (file을 소유하며 munmap 대상) */
 };
 
 struct file_load
@@ -23,10 +24,13 @@ struct file_load
 	int file_length;
 	int read_bytes;
 	int zero_bytes;
+	void *seg_start; /* 실행 파일 세그먼트 페이지만 사용 (struct load와 같음) */
+	void *seg_end;
 };
 
 void vm_file_init(void);
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva);
+bool file_lazy_load(struct page *page, void *aux);
 void *do_mmap(void *addr, size_t length, int writable,
 			  struct file *file, off_t offset);
 void do_munmap(void *va);
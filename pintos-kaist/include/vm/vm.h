@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <hash.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type
 {
@@ -21,11 +22,21 @@ enum vm_type
 	 * markers, until the value is fit in the int. */
 	VM_MARKER_0 = (1 << 3),
 	VM_MARKER_1 = (1 << 4),
+	VM_MARKER_2 = (1 << 5),
 
 	/* DO NOT EXCEED THIS VALUE. */
 	VM_MARKER_END = (1 << 31),
 };
 
+/* 실행 파일 세그먼트에서 lazy loading되는 페이지 표시 (fault-around 대상) */
+#define VM_SEGMENT VM_MARKER_0
+/* 내용이 전부 0으로 시작하는 익명 페이지 (스택, BSS)
+ * 초기화 함수 없이 폴트 시 프레임을 0으로 채우기만 하고 파일은 읽지 않음 */
+#define VM_ZERO VM_MARKER_1
+/* mmap()으로 매핑된 파일 페이지 (munmap 대상이며 자기 파일 참조를 소유)
+ * 실행 파일 세그먼트의 file-backed 페이지는 프로세스의 실행 파일(thread->running)을 빌려 씀 */
+#define VM_MMAP VM_MARKER_2
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
@@ -37,6 +48,12 @@ struct page_operations;
 struct thread;
 struct list frame_table;
 
+/* 프레임 테이블 락
+ * - 프레임 테이블과 시계 바늘, 각 프레임의 page_list/cnt_page/pin_cnt/io와 텍스트 캐시,
+ *   페이지의 frame 포인터, 스왑 슬롯과 file_list의 공유 페이지 목록을 보호
+ * - 디스크 I/O 동안에만 놓음: vm_frame_io_begin/end가 그 사이 프레임을 pin하고 io로 표시 */
+extern struct lock frame_lock;
+
 #define VM_TYPE(type) ((type)&7)
 
 /* The representation of "page".
@@ -75,6 +92,14 @@ struct frame
 	struct list page_list;
 	struct list_elem frame_elem;
 	int cnt_page;
+	int pin_cnt; /* 프레임을 잡고 있는 사용자 수 (로딩/COW 복사 중). 0보다 크면 교체 대상에서 제외 */
+	bool io;     /* 디스크와 내용을 주고받는 중 (이 프레임의 페이지를 건드리려면 vm_frame_wait로 대기) */
+
+	/* 읽기 전용 실행 파일 페이지 캐시 키 (text_inode가 NULL이면 미등록, frame_lock이 보호) */
+	struct inode *text_inode;
+	off_t text_ofs;
+	uint32_t text_read_bytes;
+	struct hash_elem text_elem;
 };
 
 struct load
@@ -83,6 +108,8 @@ struct load
 	int ofs;
 	uint32_t read_bytes;
 	uint32_t zero_bytes;
+	void *seg_start; /* 페이지가 속한 세그먼트의 범위 [seg_start, seg_end) (fault-around 창 제한) */
+	void *seg_end;
 };
 
 /* The function table for page operations.
@@ -131,6 +158,10 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
 									bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
 bool vm_claim_page(void *va);
+void vm_frame_detach(struct page *page);
+void vm_frame_wait(struct page *page);
+void vm_frame_io_begin(struct frame *frame);
+void vm_frame_io_end(struct frame *frame);
 enum vm_type page_get_type(struct page *page);
 
 #endif /* VM_VM_H */
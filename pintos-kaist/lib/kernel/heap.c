@@ -0,0 +1,153 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every element is no less
+   than its parent.  Each element points to its first child, and
+   the children of an element form a doubly linked list through
+   their `next' and `prev' links.  The `prev' link of a first
+   child points to the parent instead, and the root's `prev' and
+   `next' links are null.
+
+   Two trees are melded by making the root that is not less a
+   new first child of the other.  Removing the root leaves its
+   children as a list of trees, which are melded in pairs from
+   left to right and the pairs then melded from right to left;
+   this "two-pass" combining is what keeps removal O(lg n)
+   amortized. */
+
+static struct heap_elem *meld (struct heap *,
+		struct heap_elem *, struct heap_elem *);
+static struct heap_elem *combine (struct heap *, struct heap_elem *first);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM, which must not be in any heap, into HEAP. */
+void
+heap_insert (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->next = elem->prev = NULL;
+	heap->root = heap->root != NULL ? meld (heap, heap->root, elem) : elem;
+}
+
+/* Removes and returns the minimum element of HEAP.  Undefined
+   behavior if HEAP is empty. */
+struct heap_elem *
+heap_pop_min (struct heap *heap) {
+	struct heap_elem *min = heap_min (heap);
+
+	heap->root = combine (heap, min->child);
+	min->child = NULL;
+	return min;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	struct heap_elem *sub;
+
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	if (elem == heap->root) {
+		heap_pop_min (heap);
+		return;
+	}
+
+	/* Unlink ELEM, with its subtree, from its siblings. */
+	ASSERT (elem->prev != NULL);
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->next;
+	else
+		elem->prev->next = elem->next;
+	if (elem->next != NULL)
+		elem->next->prev = elem->prev;
+
+	/* Put the rest of the subtree back. */
+	sub = combine (heap, elem->child);
+	if (sub != NULL)
+		heap->root = meld (heap, heap->root, sub);
+	elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Returns the minimum element of HEAP.  Undefined behavior if
+   HEAP is empty. */
+struct heap_elem *
+heap_min (struct heap *heap) {
+	ASSERT (!heap_empty (heap));
+	return heap->root;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root == NULL;
+}
+
+/* Melds trees A and B, whose roots have null sibling links, and
+   returns the root of the result. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	if (heap->less (b, a, heap->aux)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Combines the list of sibling trees starting at FIRST into one
+   tree and returns its root, or a null pointer if FIRST is
+   null. */
+static struct heap_elem *
+combine (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass: meld pairs from left to right, stacking the
+	   results through their `next' links. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+
+		a->prev = a->next = NULL;
+		if (b != NULL) {
+			first = b->next;
+			b->prev = b->next = NULL;
+			a = meld (heap, a, b);
+		} else
+			first = NULL;
+		a->next = pairs;
+		pairs = a;
+	}
+
+	/* Second pass: meld the pairs from right to left. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->next;
+
+		pairs->next = NULL;
+		root = root != NULL ? meld (heap, root, pairs) : pairs;
+		pairs = next;
+	}
+	if (root != NULL)
+		root->prev = NULL;
+	return root;
+}
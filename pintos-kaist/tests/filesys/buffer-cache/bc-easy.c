@@ -43,6 +43,17 @@ test_main (void) {
   CHECK (get_fs_disk_write_cnt() <= write_cnt + TEST_SIZE / 512, 
         "check write_cnt");
 
+  /* The whole file fits in the cache, so reading it again must
+     not touch the disk at all. */
+  read_cnt = get_fs_disk_read_cnt();
+  seek(fd, 0);
+  CHECK (read (fd, buf, sizeof buf) == sizeof buf,
+        "re-read \"%s\"", file_name);
+  for (int i = 0; i < TEST_SIZE; i++)
+    if (buf[i] != 'a') fail("file content mismatch in %d : %x", i, buf[i]);
+  CHECK (get_fs_disk_read_cnt() == read_cnt,
+        "check cache hits on re-read");
+
   msg ("close \"%s\"", file_name);
   close (fd);
 }
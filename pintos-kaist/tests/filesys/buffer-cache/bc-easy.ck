@@ -9,6 +9,8 @@ check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
 (bc-easy) write "data"
 (bc-easy) check read_cnt
 (bc-easy) check write_cnt
+(bc-easy) re-read "data"
+(bc-easy) check cache hits on re-read
 (bc-easy) close "data"
 (bc-easy) end
 EOF
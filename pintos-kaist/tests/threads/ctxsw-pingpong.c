@@ -0,0 +1,58 @@
+/* Measures context switch latency.  Two threads of equal
+   priority hand control back and forth through a pair of
+   semaphores, so that every round trip is two switches, and the
+   time per switch is reported.  The numbers are informational
+   only; the test passes as long as the handoff completes. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ROUND_TRIPS 100000
+
+static thread_func pong;
+
+void
+test_ctxsw_pingpong (void) 
+{
+  struct semaphore sema[2];
+  int64_t start, elapsed;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&sema[0], 0);
+  sema_init (&sema[1], 0);
+  thread_create ("pong", PRI_DEFAULT, pong, sema);
+
+  start = timer_ticks ();
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_up (&sema[0]);
+      sema_down (&sema[1]);
+    }
+  elapsed = timer_elapsed (start);
+
+  msg ("%d round trips in %"PRId64" ticks (%"PRId64" ns per switch)",
+       ROUND_TRIPS, elapsed,
+       elapsed * (1000000000 / TIMER_FREQ) / (2 * ROUND_TRIPS));
+  pass ();
+}
+
+static void
+pong (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+  int i;
+
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_down (&sema[0]);
+      sema_up (&sema[1]);
+    }
+}
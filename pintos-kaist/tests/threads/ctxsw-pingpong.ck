@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The timing report varies from run to run.
+my ($report) = grep (/^\(ctxsw-pingpong\) \d+ round trips in \d+ ticks/,
+		     @output);
+fail "Missing timing report\n" if !defined $report;
+compare_output ("run", [grep ($_ ne $report, @output)], [<<'EOF']);
+(ctxsw-pingpong) begin
+(ctxsw-pingpong) PASS
+(ctxsw-pingpong) end
+EOF
+pass;
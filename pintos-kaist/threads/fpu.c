@@ -0,0 +1,250 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* The kernel is built with -mno-sse and -msoft-float, so only
+ * user programs ever touch the x87, MMX and SSE/AVX registers.
+ * Interrupt and system call entry leave them alone, and they
+ * only need to be switched when a different user thread starts
+ * using them.
+ *
+ * Each thread that has used the FPU owns a save area, a page so
+ * that it meets XSAVE's 64-byte alignment.  At most one thread,
+ * FPU_OWNER, has its state loaded in the registers.  When any
+ * other thread runs, CR0.TS is set, so that its first FPU
+ * instruction raises #NM and fpu_trap() swaps the states. */
+
+/* CR0 and CR4 bits. */
+#define CR0_MP (1 << 1)         /* Monitor coprocessor: WAIT obeys TS. */
+#define CR0_EM (1 << 2)         /* Emulation: FPU instructions trap. */
+#define CR0_TS (1 << 3)         /* Task switched: FPU instructions trap. */
+#define CR0_NE (1 << 5)         /* Report x87 errors through #MF. */
+#define CR4_OSFXSR (1 << 9)     /* FXSAVE/FXRSTOR and SSE enabled. */
+#define CR4_OSXMMEXCPT (1 << 10) /* Report SIMD errors through #XF. */
+#define CR4_OSXSAVE (1 << 18)   /* XSAVE/XRSTOR and XCR0 enabled. */
+
+/* CPUID.1:ECX bits. */
+#define CPUID_XSAVE (1 << 26)
+#define CPUID_AVX (1 << 28)
+
+/* XCR0 state components. */
+#define XCR0_X87 (1 << 0)
+#define XCR0_SSE (1 << 1)
+#define XCR0_AVX (1 << 2)
+
+/* Size of an FXSAVE area. */
+#define FXSAVE_SIZE 512
+
+/* Default MXCSR: all SIMD exceptions masked, round to nearest. */
+#define MXCSR_DEFAULT 0x1f80
+
+bool fpu_eager;
+
+/* True if the CPU supports XSAVE, false to use FXSAVE. */
+static bool use_xsave;
+
+/* Size of a save area in bytes. */
+static size_t fpu_size;
+
+/* Saved state of a freshly initialized FPU, which a thread's
+ * area starts from. */
+static void *fpu_template;
+
+/* Thread whose state is in the FPU registers, or a null
+ * pointer. */
+static struct thread *fpu_owner;
+
+static void fpu_trap (struct intr_frame *);
+
+static void
+cpuid (uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+	__asm __volatile ("cpuid"
+			: "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+			: "a" (leaf), "c" (subleaf));
+}
+
+static void
+xsetbv (uint32_t xcr, uint64_t val) {
+	__asm __volatile ("xsetbv"
+			: : "c" (xcr), "a" ((uint32_t) val), "d" ((uint32_t) (val >> 32)));
+}
+
+static void
+clts (void) {
+	__asm __volatile ("clts");
+}
+
+static void
+stts (void) {
+	lcr0 (rcr0 () | CR0_TS);
+}
+
+/* Saves the FPU registers into AREA.  CR0.TS must be clear. */
+static void
+fpu_save (void *area) {
+	if (use_xsave)
+		__asm __volatile ("xsave64 (%0)"
+				: : "r" (area), "a" (-1), "d" (-1) : "memory");
+	else
+		__asm __volatile ("fxsave64 (%0)" : : "r" (area) : "memory");
+}
+
+/* Loads the FPU registers from AREA.  CR0.TS must be clear. */
+static void
+fpu_restore (const void *area) {
+	if (use_xsave)
+		__asm __volatile ("xrstor64 (%0)"
+				: : "r" (area), "a" (-1), "d" (-1) : "memory");
+	else
+		__asm __volatile ("fxrstor64 (%0)" : : "r" (area) : "memory");
+}
+
+/* Enables the FPU and SSE, and XSAVE with AVX if the CPU has
+ * them, and registers the #NM handler. */
+void
+fpu_init (void) {
+	uint32_t regs[4];
+	uint32_t mxcsr = MXCSR_DEFAULT;
+
+	lcr0 ((rcr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+
+	cpuid (1, 0, regs);
+	use_xsave = (regs[2] & CPUID_XSAVE) != 0;
+	if (use_xsave) {
+		uint64_t xcr0 = XCR0_X87 | XCR0_SSE;
+
+		if (regs[2] & CPUID_AVX)
+			xcr0 |= XCR0_AVX;
+		lcr4 (rcr4 () | CR4_OSXSAVE);
+		xsetbv (0, xcr0);
+
+		/* EBX: size needed for the components enabled in XCR0. */
+		cpuid (0xd, 0, regs);
+		fpu_size = regs[1];
+	} else
+		fpu_size = FXSAVE_SIZE;
+	ASSERT (fpu_size <= PGSIZE);
+
+	fpu_template = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	__asm __volatile ("fninit");
+	__asm __volatile ("ldmxcsr %0" : : "m" (mxcsr));
+	fpu_save (fpu_template);
+	stts ();
+
+	intr_register_int (7, 0, INTR_ON, fpu_trap,
+			"#NM Device Not Available Exception");
+}
+
+/* Switches the FPU from CURR to NEXT, which is about to run.
+ * Interrupts must be off. */
+void
+fpu_switch (struct thread *curr, struct thread *next) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (fpu_eager) {
+		if (fpu_owner == curr) {
+			clts ();
+			fpu_save (curr->fpu);
+		}
+		fpu_owner = NULL;
+		if (next->fpu != NULL) {
+			clts ();
+			fpu_restore (next->fpu);
+			fpu_owner = next;
+		}
+	}
+
+	if (next == fpu_owner)
+		clts ();
+	else
+		stts ();
+}
+
+/* Discards T's FPU state, so that the next FPU instruction T
+ * executes starts from a freshly initialized FPU. */
+void
+fpu_release (struct thread *t) {
+	enum intr_level old_level;
+	void *area;
+
+	old_level = intr_disable ();
+	if (fpu_owner == t) {
+		fpu_owner = NULL;
+		stts ();
+	}
+	area = t->fpu;
+	t->fpu = NULL;
+	intr_set_level (old_level);
+
+	if (area != NULL)
+		palloc_free_page (area);
+}
+
+/* Gives DST, the running thread, a copy of SRC's FPU state.
+ * Returns false if memory is exhausted. */
+bool
+fpu_copy (struct thread *dst, struct thread *src) {
+	enum intr_level old_level;
+
+	ASSERT (dst == thread_current ());
+	ASSERT (dst->fpu == NULL);
+
+	if (src->fpu == NULL)
+		return true;
+	dst->fpu = palloc_get_page (0);
+	if (dst->fpu == NULL)
+		return false;
+
+	old_level = intr_disable ();
+	if (fpu_owner == src) {
+		/* SRC's latest state is still in the registers. */
+		clts ();
+		fpu_save (src->fpu);
+		stts ();
+	}
+	memcpy (dst->fpu, src->fpu, fpu_size);
+	intr_set_level (old_level);
+	return true;
+}
+
+/* #NM handler: the running thread used the FPU while CR0.TS was
+ * set.  Loads its state, giving it a fresh one on first use. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	if (f->cs != SEL_UCSEG) {
+		intr_dump_frame (f);
+		PANIC ("Kernel bug - FPU used in kernel");
+	}
+
+	if (curr->fpu == NULL) {
+		curr->fpu = palloc_get_page (0);
+		if (curr->fpu == NULL) {
+			printf ("%s: exit(-1)\n", curr->name);
+			curr->exit_status = -1;
+			thread_exit ();
+		}
+		memcpy (curr->fpu, fpu_template, fpu_size);
+	}
+
+	old_level = intr_disable ();
+	clts ();
+	if (fpu_owner != curr) {
+		if (fpu_owner != NULL)
+			fpu_save (fpu_owner->fpu);
+		fpu_restore (curr->fpu);
+		fpu_owner = curr;
+	}
+	intr_set_level (old_level);
+}
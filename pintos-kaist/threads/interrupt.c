@@ -344,6 +344,11 @@ intr_handler (struct intr_frame *frame) {
 
 		in_external_intr = true;
 		yield_on_return = false;
+
+		/* If this interrupt woke the CPU from a tickless idle
+		   halt, bring the tick count up to date first. */
+		if (frame->vec_no != 0x20)
+			timer_idle_exit ();
 	}
 
 	/* Invoke the interrupt's handler. */
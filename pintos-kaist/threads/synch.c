@@ -32,6 +32,18 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* Arrival counter, so that waiters of equal priority are woken
+   in the order they started waiting. */
+static uint64_t next_wait_seq;
+
+static heap_less_func cmp_waiter_priority;
+static heap_less_func cmp_cond_waiter_priority;
+static void sema_add_waiter(struct semaphore *);
+static void sema_wake_one(struct semaphore *);
+static int sema_waiter_priority(struct semaphore *);
+static int lock_waiter_priority(struct lock *);
+static bool lock_update_priority(struct lock *);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -47,7 +59,7 @@ void sema_init(struct semaphore *sema, unsigned value)
 	ASSERT(sema != NULL);
 
 	sema->value = value;
-	list_init(&sema->waiters);
+	heap_init(&sema->waiters, cmp_waiter_priority, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -69,7 +81,7 @@ void sema_down(struct semaphore *sema)
 	old_level = intr_disable();
 	while (sema->value == 0) // 세마포어 값이 0인 경우, 세마포어 값이 양수가 될 때까지 대기
 	{
-		list_insert_ordered(&sema->waiters, &thread_current()->elem, cmp_thread_priority, NULL);
+		sema_add_waiter(sema);
 		thread_block(); // 스레드는 대기 상태에 들어감
 	}
 	sema->value--; // 세마포어 값이 양수가 되면, 세마포어 값을 1 감소
@@ -113,16 +125,47 @@ void sema_up(struct semaphore *sema)
 	ASSERT(sema != NULL);
 
 	old_level = intr_disable();
-	if (!list_empty(&sema->waiters)) // 대기 중인 스레드를 깨움
-	{
-		// waiters에 들어있는 스레드가 donate를 받아 우선순위가 달라졌을 수 있기 때문에 재정렬
-		list_sort(&sema->waiters, cmp_thread_priority, NULL);
-		thread_unblock(list_entry(list_pop_front(&sema->waiters), struct thread, elem));
-	}
+	if (!heap_empty(&sema->waiters)) // 가장 우선순위가 높은 대기 스레드를 깨움
+		sema_wake_one(sema);
 	sema->value++;
 	preempt_priority();
 	intr_set_level(old_level);
-	// preempt_priority(); // unblock이 호출되며 ready_list가 수정되었으므로 선점 여부 확인
+}
+
+/* Adds the running thread to SEMA's waiters.  Interrupts must be
+   off. */
+static void
+sema_add_waiter(struct semaphore *sema)
+{
+	struct thread *curr = thread_current();
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	curr->wait_seq = next_wait_seq++;
+	curr->wait_on_sema = sema;
+	heap_insert(&sema->waiters, &curr->wait_elem);
+}
+
+/* Removes the highest-priority thread from SEMA's waiters and
+   unblocks it.  SEMA must have waiters.  Interrupts must be
+   off. */
+static void
+sema_wake_one(struct semaphore *sema)
+{
+	struct thread *t = heap_entry(heap_pop_min(&sema->waiters), struct thread, wait_elem);
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	t->wait_on_sema = NULL;
+	thread_unblock(t);
+}
+
+// 세마포어를 기다리는 스레드 중 가장 높은 priority (없으면 PRI_MIN - 1)
+static int sema_waiter_priority(struct semaphore *sema)
+{
+	if (heap_empty(&sema->waiters))
+		return PRI_MIN - 1;
+	return heap_entry(heap_min(&sema->waiters), struct thread, wait_elem)->priority;
 }
 
 static void sema_test_helper(void *sema_);
@@ -182,6 +225,7 @@ void lock_init(struct lock *lock)
 
 	lock->holder = NULL;
 	sema_init(&lock->semaphore, 1);
+	lock->priority = PRI_MIN - 1;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -194,24 +238,34 @@ void lock_init(struct lock *lock)
    we need to sleep. */
 void lock_acquire(struct lock *lock)
 {
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
+
 	ASSERT(lock != NULL);
 	ASSERT(!intr_context());
 	ASSERT(!lock_held_by_current_thread(lock));
 
-	struct thread *curr = thread_current();
-	if (lock->holder != NULL) // 이미 점유중인 락이라면
+	old_level = intr_disable();
+	while (lock->semaphore.value == 0) // 이미 점유중인 락이라면
 	{
 		curr->wait_on_lock = lock; // 현재 스레드의 wait_on_lock으로 지정
-		// lock holder의 donors list에 현재 스레드 추가
-		list_insert_ordered(&lock->holder->donations, &curr->donation_elem, cmp_donation_priority, NULL);
-		donate_priority(); // 현재 스레드의 priority를 lock holder에게 상속해줌
+		sema_add_waiter(&lock->semaphore);
+		// 현재 스레드의 priority를 lock holder에게, 그리고 wait-for 체인을 따라 상속해줌
+		// (4.4BSD 스케줄러는 donation 없음)
+		if (!thread_mlfqs && lock->holder != NULL && lock_update_priority(lock))
+			update_priority_for_donations(lock->holder);
+		thread_block();
 	}
-
-	sema_down(&lock->semaphore);
+	lock->semaphore.value--;
 
 	curr->wait_on_lock = NULL; // lock을 점유했으니 wait_on_lock에서 제거
-
-	lock->holder = thread_current();
+	lock->holder = curr;
+	lock->priority = lock_waiter_priority(lock); // 남은 대기 스레드들의 priority를 물려받음
+	heap_insert(&curr->held_locks, &lock->holder_elem);
+	// 기부받을 priority가 현재 priority보다 높을 때만 다시 계산
+	if (!thread_mlfqs && lock->priority > curr->priority)
+		update_priority_for_donations(curr);
+	intr_set_level(old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -222,14 +276,24 @@ void lock_acquire(struct lock *lock)
    interrupt handler. */
 bool lock_try_acquire(struct lock *lock)
 {
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT(lock != NULL);
 	ASSERT(!lock_held_by_current_thread(lock));
 
+	old_level = intr_disable();
 	success = sema_try_down(&lock->semaphore);
 	if (success)
-		lock->holder = thread_current();
+	{
+		lock->holder = curr;
+		lock->priority = lock_waiter_priority(lock);
+		heap_insert(&curr->held_locks, &lock->holder_elem);
+		if (!thread_mlfqs && lock->priority > curr->priority)
+			update_priority_for_donations(curr);
+	}
+	intr_set_level(old_level);
 	return success;
 }
 
@@ -241,14 +305,20 @@ bool lock_try_acquire(struct lock *lock)
    handler. */
 void lock_release(struct lock *lock)
 {
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
+
 	ASSERT(lock != NULL);
 	ASSERT(lock_held_by_current_thread(lock));
 
-	remove_donor(lock);
-	update_priority_for_donations();
-
+	old_level = intr_disable();
+	heap_remove(&curr->held_locks, &lock->holder_elem);
 	lock->holder = NULL;
+	// 이 락으로 기부받던 priority를 반납 (현재 priority보다 낮았다면 바뀔 것이 없음)
+	if (!thread_mlfqs && lock->priority >= curr->priority)
+		update_priority_for_donations(curr);
 	sema_up(&lock->semaphore);
+	intr_set_level(old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -261,11 +331,13 @@ bool lock_held_by_current_thread(const struct lock *lock)
 	return lock->holder == thread_current();
 }
 
-/* One semaphore in a list. */
+/* One semaphore in a condition variable's waiters. */
 struct semaphore_elem
 {
-	struct list_elem elem;		/* List element. */
+	struct heap_elem elem;		/* Heap element. */
 	struct semaphore semaphore; /* This semaphore. */
+	struct thread *thread;		/* Thread waiting on SEMAPHORE. */
+	uint64_t seq;				/* Order of arrival. */
 };
 
 /* Initializes condition variable COND.  A condition variable
@@ -275,7 +347,7 @@ void cond_init(struct condition *cond)
 {
 	ASSERT(cond != NULL);
 
-	list_init(&cond->waiters);
+	heap_init(&cond->waiters, cmp_cond_waiter_priority, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -301,7 +373,9 @@ void cond_init(struct condition *cond)
 // 프로세스가 block 상태로 바뀌고, 조건 변수의 신호를 기다리는 함수
 void cond_wait(struct condition *cond, struct lock *lock)
 {
+	struct thread *curr = thread_current();
 	struct semaphore_elem waiter;
+	enum intr_level old_level;
 
 	ASSERT(cond != NULL);
 	ASSERT(lock != NULL);
@@ -309,7 +383,13 @@ void cond_wait(struct condition *cond, struct lock *lock)
 	ASSERT(lock_held_by_current_thread(lock));
 
 	sema_init(&waiter.semaphore, 0);
-	list_insert_ordered(&cond->waiters, &waiter.elem, cmp_sema_priority, NULL);
+	waiter.thread = curr;
+	old_level = intr_disable();
+	waiter.seq = next_wait_seq++;
+	curr->wait_on_cond = cond;
+	curr->cond_elem = &waiter.elem;
+	heap_insert(&cond->waiters, &waiter.elem);
+	intr_set_level(old_level);
 	lock_release(lock);
 	sema_down(&waiter.semaphore);
 	lock_acquire(lock);
@@ -325,18 +405,23 @@ void cond_wait(struct condition *cond, struct lock *lock)
 // 조건 변수에서 가장 높은 우선순위를 가진 스레드에게 시그널을 보내는 함수
 void cond_signal(struct condition *cond, struct lock *lock UNUSED)
 {
+	enum intr_level old_level;
+
 	ASSERT(cond != NULL);
 	ASSERT(lock != NULL);
 	ASSERT(!intr_context());
 	ASSERT(lock_held_by_current_thread(lock));
 
-	if (!list_empty(&cond->waiters))
+	old_level = intr_disable();
+	if (!heap_empty(&cond->waiters))
 	{
-		list_sort(&cond->waiters, cmp_sema_priority, NULL);
-		sema_up(&list_entry(list_pop_front(&cond->waiters),
-							struct semaphore_elem, elem)
-					 ->semaphore);
+		struct semaphore_elem *waiter =
+			heap_entry(heap_pop_min(&cond->waiters), struct semaphore_elem, elem);
+
+		waiter->thread->wait_on_cond = NULL;
+		sema_up(&waiter->semaphore);
 	}
+	intr_set_level(old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -351,91 +436,297 @@ void cond_broadcast(struct condition *cond, struct lock *lock)
 	ASSERT(cond != NULL);
 	ASSERT(lock != NULL);
 
-	while (!list_empty(&cond->waiters))
+	while (!heap_empty(&cond->waiters))
 		cond_signal(cond, lock);
 }
 
-// 두 sema 안의 'waiters list 안의 스레드 중 제일 높은 priority'를 비교해서 높으면 true를 반환하는 함수
-bool cmp_sema_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Initializes RW, a readers-writer lock: any number of threads
+   may hold it for reading at once, or a single thread for
+   writing.
+
+   Writers are preferred: a reader also waits while a writer of
+   at least its priority is waiting, so that overlapping readers
+   cannot starve writers, but a reader of higher priority than
+   every waiting writer goes ahead.  A thread that already reads
+   some rwlock never waits for a writer that is merely waiting,
+   so that taking the read side again, e.g. from a page fault,
+   does not deadlock.
+
+   When RW becomes free it is handed directly to the waiters
+   that get it, highest priority first, so that a newcomer cannot
+   slip in before they run.  Without contention, acquiring and
+   releasing only turn interrupts off briefly. */
+void rwlock_init(struct rwlock *rw)
 {
-	struct semaphore_elem *sema_a = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem *sema_b = list_entry(b, struct semaphore_elem, elem);
+	ASSERT(rw != NULL);
 
-	struct list *waiters_a = &(sema_a->semaphore.waiters);
-	struct list *waiters_b = &(sema_b->semaphore.waiters);
+	rw->readers = 0;
+	rw->writer = NULL;
+	sema_init(&rw->read_wait, 0);
+	sema_init(&rw->write_wait, 0);
+}
 
-	struct thread *root_a = list_entry(list_begin(waiters_a), struct thread, elem);
-	struct thread *root_b = list_entry(list_begin(waiters_b), struct thread, elem);
+/* Returns true if the running thread may take RW for reading
+   without waiting.  Interrupts must be off. */
+static bool
+rwlock_can_read(struct rwlock *rw)
+{
+	struct thread *curr = thread_current();
 
-	return root_a->priority > root_b->priority;
+	if (rw->writer != NULL)
+		return false;
+	return curr->read_locks > 0 || sema_waiter_priority(&rw->write_wait) < curr->priority;
 }
 
-// donation_elem의 priority를 기준으로 정렬하는 함수
-bool cmp_donation_priority(const struct list_elem *a,
-						   const struct list_elem *b, void *aux UNUSED)
+/* Hands RW, which just became free, to its waiters: to the
+   highest-priority writer if no waiting reader has a higher
+   priority, otherwise to every reader with a higher priority than
+   all waiting writers.  Interrupts must be off. */
+static void
+rwlock_wake(struct rwlock *rw)
 {
-	struct thread *st_a = list_entry(a, struct thread, donation_elem);
-	struct thread *st_b = list_entry(b, struct thread, donation_elem);
-	return st_a->priority > st_b->priority;
+	int writer_priority = sema_waiter_priority(&rw->write_wait);
+
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(rw->writer == NULL && rw->readers == 0);
+
+	if (writer_priority >= PRI_MIN && writer_priority >= sema_waiter_priority(&rw->read_wait))
+	{
+		rw->writer = heap_entry(heap_min(&rw->write_wait.waiters), struct thread, wait_elem);
+		sema_wake_one(&rw->write_wait);
+	}
+	else
+		while (sema_waiter_priority(&rw->read_wait) > writer_priority)
+		{
+			rw->readers++;
+			sema_wake_one(&rw->read_wait);
+		}
+	preempt_priority();
 }
 
-// 현재 스레드가 원하는 락을 가진 holder에게 현재 스레드의 priority 상속
-void donate_priority(void)
+/* Acquires RW for reading, sleeping if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_acquire_read(struct rwlock *rw)
 {
-	struct thread *curr = thread_current(); // 검사중인 스레드
-	struct thread *holder;					// curr이 원하는 락을 가진드스레드
+	enum intr_level old_level;
 
-	int priority = curr->priority;
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
 
-	for (int i = 0; i < 8; i++)
+	old_level = intr_disable();
+	if (rwlock_can_read(rw))
+		rw->readers++;
+	else
 	{
-		if (curr->wait_on_lock == NULL) // 더이상 중첩되지 않았으면 종료
-			return;
-		holder = curr->wait_on_lock->holder;
-		if (holder == NULL)
-			return;
-		if (holder->priority < priority)
-			holder->priority = priority;
-		curr = holder;
+		sema_add_waiter(&rw->read_wait);
+		thread_block(); // rwlock_wake()가 readers에 포함시킨 뒤 깨움
 	}
+	thread_current()->read_locks++;
+	intr_set_level(old_level);
 }
 
-// donors list를 돌면서 현재 release될 락을 기다리고 있던 donors를 삭제
-void remove_donor(struct lock *lock)
+/* Tries to acquire RW for reading and returns true if successful
+   or false if that would have to wait.  This function will not
+   sleep. */
+bool rwlock_try_acquire_read(struct rwlock *rw)
 {
-	struct list *donations = &(thread_current()->donations); // 현재 스레드의 donations
-	struct list_elem *donor_elem;							 // 현재 스레드의 donations의 요소
-	struct thread *donor_thread;
-
-	if (list_empty(donations))
-		return;
+	enum intr_level old_level;
+	bool success;
 
-	donor_elem = list_front(donations);
+	ASSERT(rw != NULL);
 
-	while (1)
+	old_level = intr_disable();
+	success = rwlock_can_read(rw);
+	if (success)
 	{
-		donor_thread = list_entry(donor_elem, struct thread, donation_elem);
-		if (donor_thread->wait_on_lock == lock)		   // 현재 release될 lock을 기다리던 스레드라면
-			list_remove(&donor_thread->donation_elem); // 목록에서 제거
-		donor_elem = list_next(donor_elem);
-		if (donor_elem == list_end(donations))
-			return;
+		rw->readers++;
+		thread_current()->read_locks++;
 	}
+	intr_set_level(old_level);
+	return success;
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void rwlock_release_read(struct rwlock *rw)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+
+	old_level = intr_disable();
+	ASSERT(rw->readers > 0 && rw->writer == NULL);
+	thread_current()->read_locks--;
+	if (--rw->readers == 0)
+		rwlock_wake(rw);
+	intr_set_level(old_level);
 }
 
-// 락을 release하고 나서 priority를 상속 받기 이전 상태로 돌리는 함수
-void update_priority_for_donations(void)
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  RW must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_acquire_write(struct rwlock *rw)
 {
 	struct thread *curr = thread_current();
-	struct list *donations = &(thread_current()->donations);
-	struct thread *donations_root;
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
 
-	if (list_empty(donations)) // donors가 없으면 (donor가 하나였던 경우)
+	old_level = intr_disable();
+	ASSERT(rw->writer != curr);
+	if (rw->writer == NULL && rw->readers == 0)
+		rw->writer = curr;
+	else
 	{
-		curr->priority = curr->init_priority; // 최초의 priority로 변경
-		return;
+		sema_add_waiter(&rw->write_wait);
+		thread_block(); // rwlock_wake()가 writer로 지정한 뒤 깨움
 	}
+	ASSERT(rw->writer == curr);
+	intr_set_level(old_level);
+}
+
+/* Tries to acquire RW for writing and returns true if successful
+   or false if another thread holds it.  This function will not
+   sleep. */
+bool rwlock_try_acquire_write(struct rwlock *rw)
+{
+	enum intr_level old_level;
+	bool success;
 
-	donations_root = list_entry(list_front(donations), struct thread, donation_elem);
-	curr->priority = donations_root->priority;
+	ASSERT(rw != NULL);
+
+	old_level = intr_disable();
+	success = rw->writer == NULL && rw->readers == 0;
+	if (success)
+		rw->writer = thread_current();
+	intr_set_level(old_level);
+	return success;
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void rwlock_release_write(struct rwlock *rw)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+
+	old_level = intr_disable();
+	ASSERT(rw->writer == thread_current());
+	rw->writer = NULL;
+	rwlock_wake(rw);
+	intr_set_level(old_level);
+}
+
+// 두 스레드의 priority를 비교해서 높으면 true를 반환하는 함수 (같으면 먼저 기다린 스레드)
+static bool cmp_waiter_priority(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
+{
+	struct thread *st_a = heap_entry(a, struct thread, wait_elem);
+	struct thread *st_b = heap_entry(b, struct thread, wait_elem);
+
+	if (st_a->priority != st_b->priority)
+		return st_a->priority > st_b->priority;
+	return st_a->wait_seq < st_b->wait_seq;
+}
+
+// 조건 변수에서 기다리는 두 스레드의 priority를 비교해서 높으면 true를 반환하는 함수
+static bool cmp_cond_waiter_priority(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
+{
+	struct semaphore_elem *sema_a = heap_entry(a, struct semaphore_elem, elem);
+	struct semaphore_elem *sema_b = heap_entry(b, struct semaphore_elem, elem);
+
+	if (sema_a->thread->priority != sema_b->thread->priority)
+		return sema_a->thread->priority > sema_b->thread->priority;
+	return sema_a->seq < sema_b->seq;
+}
+
+// 두 락이 holder에게 기부하는 priority를 비교해서 높으면 true를 반환하는 함수
+bool cmp_lock_priority(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
+{
+	struct lock *lock_a = heap_entry(a, struct lock, holder_elem);
+	struct lock *lock_b = heap_entry(b, struct lock, holder_elem);
+	return lock_a->priority > lock_b->priority;
+}
+
+/* Changes T's priority to PRIORITY, keeping the semaphore and
+   condition variable waiters that T is in ordered.  (T may be in
+   a condition variable's waiters before it blocks.)  Interrupts
+   must be off. */
+void waiter_set_priority(struct thread *t, int priority)
+{
+	struct semaphore *sema = t->wait_on_sema;
+	struct condition *cond = t->wait_on_cond;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (sema != NULL)
+		heap_remove(&sema->waiters, &t->wait_elem);
+	if (cond != NULL)
+		heap_remove(&cond->waiters, t->cond_elem);
+	t->priority = priority;
+	if (sema != NULL)
+		heap_insert(&sema->waiters, &t->wait_elem);
+	if (cond != NULL)
+		heap_insert(&cond->waiters, t->cond_elem);
+}
+
+// 락을 기다리는 스레드 중 가장 높은 priority (없으면 PRI_MIN - 1)
+static int lock_waiter_priority(struct lock *lock)
+{
+	return sema_waiter_priority(&lock->semaphore);
+}
+
+/* Recomputes the priority that LOCK donates to its holder after
+   its waiters changed, keeping the holder's held_locks ordered.
+   Returns true if it changed.  Interrupts must be off. */
+static bool lock_update_priority(struct lock *lock)
+{
+	int priority = lock_waiter_priority(lock);
+
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(lock->holder != NULL);
+
+	if (priority == lock->priority)
+		return false;
+	heap_remove(&lock->holder->held_locks, &lock->holder_elem);
+	lock->priority = priority;
+	heap_insert(&lock->holder->held_locks, &lock->holder_elem);
+	return true;
+}
+
+/* Recomputes T's effective priority: the higher of its own
+   priority and the highest priority among the threads waiting for
+   the locks it holds.  If that changes and T is itself waiting
+   for a lock, the change is passed on to the lock's holder, and
+   so on along the wait-for chain, however long it is.  Each step
+   takes O(lg n) time and stops as soon as a priority does not
+   change.  Interrupts must be off. */
+void update_priority_for_donations(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	while (t != NULL)
+	{
+		struct lock *lock;
+		int priority = t->init_priority;
+
+		if (!heap_empty(&t->held_locks))
+		{
+			int donated = heap_entry(heap_min(&t->held_locks), struct lock, holder_elem)->priority;
+			if (donated > priority)
+				priority = donated;
+		}
+		if (priority == t->priority)
+			return;
+		thread_set_effective_priority(t, priority);
+
+		// t가 기다리는 락의 holder에게 다시 상속
+		lock = t->wait_on_lock;
+		if (lock == NULL || lock->holder == NULL || !lock_update_priority(lock))
+			return;
+		t = lock->holder;
+	}
 }
\ No newline at end of file
@@ -5,11 +5,14 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,10 +27,28 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO list
+   per priority level, and bit P of ready_bitmap is set if and
+   only if ready_queues[P] is non-empty, so that both inserting a
+   thread and finding the highest-priority one take O(1) time. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+
+/* Threads sleeping in thread_sleep(), ordered by wakeup_ticks so
+   that the earliest sleeper is found in O(1) time and inserting
+   or waking a thread takes O(lg n) time. */
+static struct heap sleep_queue;
+
+/* Every thread, for the 4.4BSD scheduler's once-a-second update. */
+static struct list all_list;
+
+/* Number of threads in the ready queues. */
+static int ready_cnt;
+
+/* 4.4BSD scheduler: estimated number of threads ready to run over
+   the past minute. */
+static fixed_t load_avg;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -41,6 +62,17 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Pages of dead threads and fd tables of exited threads, kept
+   for reuse so that creating a thread usually needs neither the
+   page allocator nor clearing whole pages.  At most
+   RECYCLE_MAX of each are kept.  Both are accessed with
+   interrupts off. */
+#define RECYCLE_MAX 8
+static struct list thread_page_cache; /* Linked through `elem'. */
+static size_t thread_page_cnt;
+static void *fdt_cache; /* Linked through each table's first slot. */
+static size_t fdt_cnt;
+
 /* Statistics. */
 static long long idle_ticks;   /* # of timer ticks spent idle. */
 static long long kernel_ticks; /* # of timer ticks in kernel threads. */
@@ -59,10 +91,19 @@ static void kernel_thread(thread_func *, void *aux);
 
 static void idle(void *aux UNUSED);
 static struct thread *next_thread_to_run(void);
+static void ready_push(struct thread *);
+static void ready_remove(struct thread *);
+static int ready_max_priority(void);
+static heap_less_func cmp_thread_ticks;
+static void mlfqs_tick(struct thread *);
+static void mlfqs_update_priority(struct thread *);
 static void init_thread(struct thread *, const char *name, int priority);
+static void thread_first_launch(void);
 static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
+static struct thread *thread_page_alloc(void);
+static void thread_page_free(struct thread *);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -107,9 +148,13 @@ void thread_init(void)
 
 	/* Init the globla thread context */
 	lock_init(&tid_lock);
-	list_init(&ready_list);
-	list_init(&sleep_list); // sleep_list 초기화
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init(&ready_queues[pri]);
+	ready_bitmap = 0;
+	heap_init(&sleep_queue, cmp_thread_ticks, NULL); // sleep_queue 초기화
+	list_init(&all_list);
 	list_init(&destruction_req);
+	list_init(&thread_page_cache);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread();
@@ -150,8 +195,12 @@ void thread_tick(void)
 	else
 		kernel_ticks++;
 
-	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	if (thread_mlfqs)
+		mlfqs_tick(t);
+
+	/* Enforce preemption.  The idle thread gives up the CPU as
+	   soon as anything is ready, so it needs no time slice. */
+	if (t != idle_thread && ++thread_ticks >= TIME_SLICE)
 		intr_yield_on_return();
 }
 
@@ -178,46 +227,80 @@ void thread_print_stats(void)
    PRIORITY, but no actual priority scheduling is implemented.
    Priority scheduling is the goal of Problem 1-3. */
 
-bool cmp_thread_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Yields the CPU if a ready thread has a higher priority than the
+   running thread.  In an interrupt handler, the yield is deferred
+   until the handler returns. */
+void preempt_priority(void)
 {
-	struct thread *st_a = list_entry(a, struct thread, elem);
-	struct thread *st_b = list_entry(b, struct thread, elem);
-	return st_a->priority > st_b->priority;
+	struct thread *cur = thread_current();
+
+	if (cur == idle_thread)
+		return;
+	if (ready_max_priority() > cur->priority)
+	{ // 준비 큐의 최고 우선순위가 현재 실행 스레드보다 높으면, 양보
+		if (intr_context())
+			intr_yield_on_return();
+		else
+			thread_yield();
+	}
 }
 
-void preempt_priority(void)
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching ready queue if it is ready to run and keeping any
+   semaphore or condition variable waiters that T is in ordered. */
+void thread_set_effective_priority(struct thread *t, int priority)
 {
-	// ASSERT(thread_current() != idle_thread);
-	// ASSERT(!list_empty(&ready_list))
-	if (thread_current() == idle_thread)
-		return;
-	if (list_empty(&ready_list))
-		return;
-	struct thread *cur = thread_current();
-	struct thread *first_ready = list_entry(list_front(&ready_list), struct thread, elem);
+	enum intr_level old_level;
+
+	ASSERT(is_thread(t));
+	ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
 
-	if (first_ready->priority > cur->priority)
-	{ // ready_list 첫번째 스레드가 현재 실행 스레드보다 우선순위가 높으면, 양보
-		thread_yield();
+	old_level = intr_disable();
+	if (t->priority == priority)
+		;
+	else if (t->status == THREAD_READY)
+	{
+		ready_remove(t);
+		waiter_set_priority(t, priority);
+		ready_push(t);
 	}
+	else
+		waiter_set_priority(t, priority);
+	intr_set_level(old_level);
 }
 
 tid_t thread_create(const char *name, int priority,
 					thread_func *function, void *aux)
 {
 	struct thread *t;
+	struct switch_threads_frame *frame;
+	struct file **fdt;
 	tid_t tid;
 
 	ASSERT(function != NULL);
 
-	/* Allocate thread. */
-	t = palloc_get_page(PAL_ZERO);
+	/* Allocate thread and its fd table. */
+	t = thread_page_alloc();
 	if (t == NULL)
 		return TID_ERROR;
+	fdt = thread_fdt_alloc();
+	if (fdt == NULL)
+	{
+		thread_page_free(t);
+		return TID_ERROR;
+	}
 
 	/* Initialize thread. */
 	init_thread(t, name, priority);
 	tid = t->tid = allocate_tid();
+	t->fdt = fdt;
+	if (thread_mlfqs && function != idle)
+	{ // 4.4BSD 스케줄러에서는 부모의 nice, recent_cpu를 물려받고 priority 인자는 무시
+		t->nice = thread_current()->nice;
+		t->recent_cpu = thread_current()->recent_cpu;
+		mlfqs_update_priority(t);
+		t->init_priority = t->priority;
+	}
 
 	/* Call the kernel_thread if it scheduled. 커널 스레드 레지스터 초기화
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -230,14 +313,17 @@ tid_t thread_create(const char *name, int priority,
 	t->tf.cs = SEL_KCSEG;
 	t->tf.eflags = FLAG_IF;
 
+	/* Fake switch_threads() frame at the top of the stack, so that
+	 * the first switch to T returns into thread_first_launch(), with
+	 * the stack aligned as if it had been called. */
+	frame = (struct switch_threads_frame *)((uint8_t *)t + PGSIZE - sizeof(void *)) - 1;
+	memset(frame, 0, sizeof *frame);
+	frame->rip = thread_first_launch;
+	t->switch_rsp = (uint64_t)frame;
+
 #ifdef VM
 	supplemental_page_table_init(&t->spt);
 #endif
-	t->fdt = palloc_get_multiple(PAL_ZERO, 3);
-	if (t->fdt == NULL)
-	{
-		return TID_ERROR;
-	}
 	/* 자식 리스트에 추가 */
 	list_push_back(&thread_current()->child_list, &t->child_elem);
 	/* Add to run queue. */
@@ -276,7 +362,7 @@ void thread_unblock(struct thread *t)
 
 	old_level = intr_disable();
 	ASSERT(t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list, &t->elem, cmp_thread_priority, NULL);
+	ready_push(t);
 	t->status = THREAD_READY;
 	intr_set_level(old_level);
 	// preempt_priority();
@@ -323,6 +409,7 @@ void thread_exit(void)
 #ifdef USERPROG
 	process_exit();
 #endif
+	fpu_release(thread_current());
 	// struct thread *curr = thread_current();
 	// /* 프로세스 디스크립터에 프로세스 종료를 알림 */
 	// curr->terminated = true;
@@ -331,6 +418,7 @@ void thread_exit(void)
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable();
+	list_remove(&thread_current()->all_elem);
 	do_schedule(THREAD_DYING);
 	NOT_REACHED();
 }
@@ -346,7 +434,7 @@ void thread_yield(void)
 
 	old_level = intr_disable(); // 인터럽트 비활성
 	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, cmp_thread_priority, NULL);
+		ready_push(curr);
 	do_schedule(THREAD_READY); // 현재 실행 중인 스레드의 상태를 준비 상태로 변경, 컨텍스트 전환
 	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
 }
@@ -362,9 +450,9 @@ void thread_sleep(int64_t ticks)
 	ASSERT(curr != idle_thread); // 현재 스레드가 idle이 아닐 때만
 	curr->wakeup_ticks = ticks;	 // 일어날 시각 저장
 
-	list_insert_ordered(&sleep_list, &curr->elem, cmp_thread_ticks, NULL); // sleep_list에 추가
+	heap_insert(&sleep_queue, &curr->sleep_elem); // sleep_queue에 추가
 
-	thread_block(); // 현재 스레드 재우고 ready_list의 스레드 실행
+	thread_block(); // 현재 스레드 재우고 준비 큐의 스레드 실행
 
 	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
 }
@@ -374,36 +462,50 @@ void thread_wakeup(int64_t current_ticks)
 	enum intr_level old_level;
 	old_level = intr_disable(); // 인터럽트 비활성
 
-	struct list_elem *curr_elem = list_begin(&sleep_list); // sleep_list의 첫번째 요소(빈 경우 NULL)
-	while (curr_elem != list_end(&sleep_list))
+	while (!heap_empty(&sleep_queue))
 	{
-		struct thread *curr_thread = list_entry(curr_elem, struct thread, elem); // 현재 검사중인 elem의 스레드
+		struct thread *first = heap_entry(heap_min(&sleep_queue), struct thread, sleep_elem); // 가장 먼저 깰 스레드
 
-		if (current_ticks >= curr_thread->wakeup_ticks) // 깰 시간이 됐으면
-		{
-			curr_elem = list_remove(curr_elem); // sleep_list에서 제거 & curr_elem에는 다음 elem이 담김
-			thread_unblock(curr_thread);		// ready_list로 이동
-			preempt_priority();
-		}
-		else
+		if (current_ticks < first->wakeup_ticks) // 아직 깰 시간이 아니면 나머지도 마찬가지
 			break;
+		heap_pop_min(&sleep_queue); // sleep_queue에서 제거
+		thread_unblock(first);		// 준비 큐로 이동
 	}
+	preempt_priority();
 	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
 }
 
+/* Returns the tick at which the earliest sleeping thread is due
+   to wake up, or INT64_MAX if no thread is sleeping.  Interrupts
+   must be off. */
+int64_t thread_next_wakeup(void)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (heap_empty(&sleep_queue))
+		return INT64_MAX;
+	return heap_entry(heap_min(&sleep_queue), struct thread, sleep_elem)->wakeup_ticks;
+}
+
 // 두 스레드의 wakeup_ticks를 비교해서 작으면 true를 반환하는 함수
-bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+static bool cmp_thread_ticks(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED)
 {
-	struct thread *st_a = list_entry(a, struct thread, elem);
-	struct thread *st_b = list_entry(b, struct thread, elem);
+	struct thread *st_a = heap_entry(a, struct thread, sleep_elem);
+	struct thread *st_b = heap_entry(b, struct thread, sleep_elem);
 	return st_a->wakeup_ticks < st_b->wakeup_ticks;
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void thread_set_priority(int new_priority)
 {
+	enum intr_level old_level;
+
+	if (thread_mlfqs) // 4.4BSD 스케줄러가 priority를 직접 관리
+		return;
+	old_level = intr_disable();
 	thread_current()->init_priority = new_priority;
-	update_priority_for_donations();
+	update_priority_for_donations(thread_current()); // 기부받은 priority가 더 높으면 유지
+	intr_set_level(old_level);
 	preempt_priority();
 }
 
@@ -434,31 +536,118 @@ int thread_get_priority(void)
 // 		thread_yield();
 // }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED)
+/* Sets the current thread's nice value to NICE and recalculates
+   its priority, yielding if it no longer has the highest. */
+void thread_set_nice(int nice)
 {
-	/* TODO: Your implementation goes here */
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
+
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
+	if (!thread_mlfqs) // priority 스케줄러에서는 값만 기록 (기부받은 priority를 덮어쓰지 않음)
+	{
+		curr->nice = nice;
+		return;
+	}
+	old_level = intr_disable();
+	curr->nice = nice;
+	mlfqs_update_priority(curr);
+	intr_set_level(old_level);
+	preempt_priority();
 }
 
 /* Returns the current thread's nice value. */
 int thread_get_nice(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int load_avg_100 = fixed_to_int_round(fixed_mul_int(load_avg, 100));
+	intr_set_level(old_level);
+	return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void)
 {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable();
+	int recent_cpu_100 = fixed_to_int_round(fixed_mul_int(thread_current()->recent_cpu, 100));
+	intr_set_level(old_level);
+	return recent_cpu_100;
+}
+
+/* 4.4BSD scheduler work for one timer tick, with CURR running.
+
+   Between once-a-second updates, only the running thread's
+   recent_cpu changes, so on every fourth tick only its priority
+   is recalculated; every other thread keeps the priority (and
+   ready queue) it already has.  Once a second, load_avg is
+   updated and every thread's recent_cpu decays, so all
+   priorities are recalculated then. */
+static void
+mlfqs_tick(struct thread *curr)
+{
+	int64_t now = timer_ticks();
+	bool changed = false;
+
+	if (curr != idle_thread)
+		curr->recent_cpu = add_fixed(curr->recent_cpu, int_to_fixed(1));
+
+	if (now % TIMER_FREQ == 0)
+	{
+		int ready_threads = ready_cnt + (curr != idle_thread ? 1 : 0);
+		fixed_t coef;
+		struct list_elem *e;
+
+		// load_avg = (59/60) * load_avg + (1/60) * ready_threads
+		load_avg = add_fixed(mul_fixed(div_fixed(int_to_fixed(59), int_to_fixed(60)), load_avg),
+							 fixed_div_int(int_to_fixed(ready_threads), 60));
+
+		// recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice
+		coef = div_fixed(fixed_mul_int(load_avg, 2),
+						 add_fixed(fixed_mul_int(load_avg, 2), int_to_fixed(1)));
+		for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+		{
+			struct thread *t = list_entry(e, struct thread, all_elem);
+
+			if (t == idle_thread)
+				continue;
+			t->recent_cpu = add_fixed(mul_fixed(coef, t->recent_cpu), int_to_fixed(t->nice));
+			mlfqs_update_priority(t);
+		}
+		changed = true;
+	}
+	else if (now % 4 == 0 && curr != idle_thread)
+	{
+		mlfqs_update_priority(curr);
+		changed = true;
+	}
+
+	if (changed)
+		preempt_priority();
+}
+
+/* Recalculates T's priority from its recent_cpu and nice:
+   PRI_MAX - (recent_cpu / 4) - (nice * 2), rounded down and
+   clamped to the valid range. */
+static void
+mlfqs_update_priority(struct thread *t)
+{
+	int priority = PRI_MAX - fixed_to_int(fixed_div_int(t->recent_cpu, 4)) - t->nice * 2;
+
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	thread_set_effective_priority(t, priority);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -484,6 +673,10 @@ idle(void *idle_started_ UNUSED)
 		intr_disable();
 		thread_block();
 
+		/* Nothing else can run until an interrupt arrives, so
+		   don't take timer interrupts that have nothing to do. */
+		timer_idle_enter();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -519,6 +712,8 @@ kernel_thread(thread_func *function, void *aux)
 static void
 init_thread(struct thread *t, const char *name, int priority)
 {
+	enum intr_level old_level;
+
 	ASSERT(t != NULL);
 	ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT(name != NULL);
@@ -532,7 +727,9 @@ init_thread(struct thread *t, const char *name, int priority)
 
 	t->init_priority = priority;
 	t->wait_on_lock = NULL;
-	list_init(&(t->donations));
+	heap_init(&t->held_locks, cmp_lock_priority, NULL);
+	t->wait_on_sema = NULL;
+	t->wait_on_cond = NULL;
 
 	t->exit_status = 0;
 	t->next_fd = 2;
@@ -540,6 +737,12 @@ init_thread(struct thread *t, const char *name, int priority)
 	sema_init(&t->exit_sema, 0);
 	sema_init(&t->wait_sema, 0);
 	list_init(&(t->child_list));
+
+	t->nice = NICE_DEFAULT;
+	t->recent_cpu = 0;
+	old_level = intr_disable();
+	list_push_back(&all_list, &t->all_elem);
+	intr_set_level(old_level);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
@@ -550,10 +753,49 @@ init_thread(struct thread *t, const char *name, int priority)
 static struct thread *
 next_thread_to_run(void)
 {
-	if (list_empty(&ready_list))
+	int pri = ready_max_priority();
+	struct thread *t;
+
+	if (pri < 0)
 		return idle_thread;
-	else
-		return list_entry(list_pop_front(&ready_list), struct thread, elem);
+	t = list_entry(list_pop_front(&ready_queues[pri]), struct thread, elem);
+	if (list_empty(&ready_queues[pri]))
+		ready_bitmap &= ~(1ULL << pri);
+	ready_cnt--;
+	return t;
+}
+
+/* Appends T to the ready queue of its priority.  Interrupts must
+   be off. */
+static void
+ready_push(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	list_push_back(&ready_queues[t->priority], &t->elem);
+	ready_bitmap |= 1ULL << t->priority;
+	ready_cnt++;
+}
+
+/* Removes ready thread T from its ready queue.  Interrupts must
+   be off. */
+static void
+ready_remove(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	list_remove(&t->elem);
+	if (list_empty(&ready_queues[t->priority]))
+		ready_bitmap &= ~(1ULL << t->priority);
+	ready_cnt--;
+}
+
+/* Returns the highest priority among ready threads, or -1 if no
+   thread is ready. */
+static int
+ready_max_priority(void)
+{
+	return ready_bitmap != 0 ? 63 - __builtin_clzll(ready_bitmap) : -1;
 }
 
 /* Use iretq to launch the thread */
@@ -586,12 +828,20 @@ void do_iret(struct intr_frame *tf)
 		: "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Switches to thread TH.
 
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+   At this function's invocation, the running thread has already
+   been taken off the CPU by schedule(), the new thread's address
+   space is active, and interrupts are still disabled.
+
+   Every switch gets here through an ordinary call chain from
+   thread_block(), thread_yield() or thread_exit() -- also on
+   preemption, where intr_handler() calls thread_yield() after
+   intr_entry has saved the interrupted context on this stack.  So
+   switch_threads() only needs to save the callee-saved registers
+   and the stack pointer.  A full intr_frame and iretq are used
+   only to start a new thread (thread_first_launch()) and to enter
+   user mode.
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
@@ -599,62 +849,19 @@ void do_iret(struct intr_frame *tf)
 static void
 thread_launch(struct thread *th)
 {
-	uint64_t tf_cur = (uint64_t)&running_thread()->tf;
-	uint64_t tf = (uint64_t)&th->tf;
+	struct thread *curr = running_thread();
+
 	ASSERT(intr_get_level() == INTR_OFF);
+	switch_threads(&curr->switch_rsp, th->switch_rsp);
+}
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile(
-		/* Store registers that will be used. */
-		"push %%rax\n"
-		"push %%rbx\n"
-		"push %%rcx\n"
-		/* Fetch input once */
-		"movq %0, %%rax\n"
-		"movq %1, %%rcx\n"
-		"movq %%r15, 0(%%rax)\n"
-		"movq %%r14, 8(%%rax)\n"
-		"movq %%r13, 16(%%rax)\n"
-		"movq %%r12, 24(%%rax)\n"
-		"movq %%r11, 32(%%rax)\n"
-		"movq %%r10, 40(%%rax)\n"
-		"movq %%r9, 48(%%rax)\n"
-		"movq %%r8, 56(%%rax)\n"
-		"movq %%rsi, 64(%%rax)\n"
-		"movq %%rdi, 72(%%rax)\n"
-		"movq %%rbp, 80(%%rax)\n"
-		"movq %%rdx, 88(%%rax)\n"
-		"pop %%rbx\n" // Saved rcx
-		"movq %%rbx, 96(%%rax)\n"
-		"pop %%rbx\n" // Saved rbx
-		"movq %%rbx, 104(%%rax)\n"
-		"pop %%rbx\n" // Saved rax
-		"movq %%rbx, 112(%%rax)\n"
-		"addq $120, %%rax\n"
-		"movw %%es, (%%rax)\n"
-		"movw %%ds, 8(%%rax)\n"
-		"addq $32, %%rax\n"
-		"call __next\n" // read the current rip.
-		"__next:\n"
-		"pop %%rbx\n"
-		"addq $(out_iret -  __next), %%rbx\n"
-		"movq %%rbx, 0(%%rax)\n" // rip
-		"movw %%cs, 8(%%rax)\n"	 // cs
-		"pushfq\n"
-		"popq %%rbx\n"
-		"mov %%rbx, 16(%%rax)\n" // eflags
-		"mov %%rsp, 24(%%rax)\n" // rsp
-		"movw %%ss, 32(%%rax)\n"
-		"mov %%rcx, %%rdi\n"
-		"call do_iret\n"
-		"out_iret:\n"
-		:
-		: "g"(tf_cur), "g"(tf)
-		: "memory");
+/* Where a new thread's first switch_threads() returns to.  Enters
+   kernel_thread() through the intr_frame set up by
+   thread_create(). */
+static void
+thread_first_launch(void)
+{
+	do_iret(&running_thread()->tf);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -670,7 +877,9 @@ do_schedule(int status)
 	{
 		struct thread *victim =
 			list_entry(list_pop_front(&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		if (victim->fdt != NULL) // process_exit()을 거치지 않은 커널 스레드
+			thread_fdt_free(victim->fdt);
+		thread_page_free(victim);
 	}
 	thread_current()->status = status;
 	schedule();
@@ -713,10 +922,91 @@ schedule(void)
 
 		/* Before switching the thread, we first save the information
 		 * of current running. */
+		fpu_switch(curr, next);
 		thread_launch(next);
 	}
 }
 
+/* Returns a page for a new thread, recycling a dead thread's page
+   if one is cached, or a null pointer if memory is exhausted.
+   Only the struct thread part is initialized later, by
+   init_thread(); the rest of the page is the kernel stack, which
+   needs no clearing. */
+static struct thread *
+thread_page_alloc(void)
+{
+	struct thread *t = NULL;
+	enum intr_level old_level = intr_disable();
+
+	if (!list_empty(&thread_page_cache))
+	{
+		t = list_entry(list_pop_front(&thread_page_cache), struct thread, elem);
+		thread_page_cnt--;
+	}
+	intr_set_level(old_level);
+
+	return t != NULL ? t : palloc_get_page(PAL_ZERO);
+}
+
+/* Frees T's page, or keeps it for reuse by thread_page_alloc(). */
+static void
+thread_page_free(struct thread *t)
+{
+	enum intr_level old_level = intr_disable();
+
+	if (thread_page_cnt < RECYCLE_MAX)
+	{
+		t->magic = 0;
+		list_push_front(&thread_page_cache, &t->elem);
+		thread_page_cnt++;
+	}
+	else
+		palloc_free_page(t);
+	intr_set_level(old_level);
+}
+
+/* Returns an empty fd table of FDT_COUNT entries, recycling an
+   exited thread's table if one is cached, or a null pointer if
+   memory is exhausted. */
+struct file **
+thread_fdt_alloc(void)
+{
+	struct file **fdt = NULL;
+	enum intr_level old_level = intr_disable();
+
+	if (fdt_cache != NULL)
+	{
+		fdt = fdt_cache;
+		fdt_cache = *(void **)fdt;
+		fdt[0] = NULL;
+		fdt_cnt--;
+	}
+	intr_set_level(old_level);
+
+	return fdt != NULL ? fdt : palloc_get_multiple(PAL_ZERO, FDT_PAGE_COUNT);
+}
+
+/* Frees FDT, obtained from thread_fdt_alloc(), or keeps it for
+   reuse.  The files in it must already be closed.  Only the
+   FDT_COUNT slots that can have been used are cleared. */
+void thread_fdt_free(struct file **fdt)
+{
+	enum intr_level old_level;
+
+	memset(fdt, 0, FDT_COUNT * sizeof *fdt);
+
+	old_level = intr_disable();
+	if (fdt_cnt < RECYCLE_MAX)
+	{
+		*(void **)fdt = fdt_cache;
+		fdt_cache = fdt;
+		fdt_cnt++;
+	}
+	else
+		palloc_free_multiple(fdt, FDT_PAGE_COUNT);
+	intr_set_level(old_level);
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid(void)
@@ -12,6 +12,7 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
@@ -288,6 +289,10 @@ __do_fork(void *aux)
 
 	process_activate(current);
 #ifdef VM
+	// 자식의 실행 파일 세그먼트 페이지가 빌려 쓸 실행 파일 (쓰기 금지 상태도 함께 복제됨)
+	current->running = file_duplicate(parent->running);
+	if (current->running == NULL)
+		goto error;
 	supplemental_page_table_init(&current->spt);
 	if (!supplemental_page_table_copy(&current->spt, &parent->spt))
 		goto error;
@@ -295,6 +300,8 @@ __do_fork(void *aux)
 	if (!pml4_for_each(parent->pml4, duplicate_pte, parent))
 		goto error;
 #endif
+	if (!fpu_copy(current, parent))
+		goto error;
 
 	/* TODO: Your code goes here.
 	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
@@ -302,8 +309,6 @@ __do_fork(void *aux)
 	 * TODO:       from the fork() until this function successfully duplicates
 	 * TODO:       the resources of parent.*/
 	// FDT복사
-	if (!lock_held_by_current_thread(&filesys_lock))
-		lock_acquire(&filesys_lock);
 	for (int i = 0; i < FDT_COUNT; i++)
 	{
 		struct file *file = parent->fdt[i];
@@ -317,8 +322,6 @@ __do_fork(void *aux)
 		}
 		current->fdt[i] = file;
 	}
-	if (lock_held_by_current_thread(&filesys_lock))
-		lock_release(&filesys_lock);
 	current->next_fd = parent->next_fd;
 
 	// 로드가 완료될 때까지 기다리고 있던 부모 대기 해제
@@ -351,6 +354,10 @@ int process_exec(void *f_name)
 
 	/* We first kill the current context */
 	process_cleanup();
+	// 이전 실행 파일은 그 세그먼트 페이지가 모두 해제되었으므로 닫음
+	file_close(curr->running);
+	curr->running = NULL;
+	fpu_release(curr); // 새 프로그램은 초기화된 FPU 상태로 시작
 
 	char *parse[64];
 	char *token, *save_ptr;
@@ -364,12 +371,7 @@ int process_exec(void *f_name)
 		count++;
 	}
 	/* And then load the binary */
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	success = load(file_name, &_if);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 
 	/* If load failed, quit. */
 
@@ -421,9 +423,6 @@ void process_exit(void)
 {
 	struct thread *curr = thread_current(); // 자식
 
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
 	for (int i = 2; i < FDT_COUNT; i++)
 	{
 		/* 현재 파일 디스크립터가 열린 상태인 경우 */
@@ -435,12 +434,13 @@ void process_exit(void)
 		}
 	}
 	sema_up(&curr->wait_sema);
-	palloc_free_multiple(curr->fdt, 3);
-	file_close(curr->running);
+	thread_fdt_free(curr->fdt);
+	curr->fdt = NULL;
+	// 실행 파일 세그먼트 페이지가 실행 파일을 빌려 쓰므로 페이지를 모두 해제한 뒤에 닫음
 	process_cleanup();
+	file_close(curr->running);
+	curr->running = NULL;
 	hash_destroy(&curr->spt.spt_hash, NULL);
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 	sema_down(&curr->exit_sema);
 }
 
@@ -842,18 +842,12 @@ lazy_load_segment(struct page *page, void *aux_)
 	// aux는 여기에서만 쓰이므로 정보 전달 후 즉시 free
 	free(aux);
 
-	// 파일 시스템 락을 획득한 뒤 file_read 수행
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
-	file_seek(file, ofs);
-	if (file_read(file, page->frame->kva, read_bytes) != (int)read_bytes)
+	// 지정한 오프셋에서 file_read_at 수행 (file->pos를 건드리지 않음)
+	if (file_read_at(file, page->frame->kva, read_bytes, ofs) != (int)read_bytes)
 	{
 		// 파일 읽기 실패 시 실패 처리 (페이지 fault 처리 실패)
 		return false;
 	}
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 
 	// 읽고 남은 공간은 0으로 초기화
 	memset(page->frame->kva + read_bytes, 0, zero_bytes);
@@ -882,6 +876,10 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT(pg_ofs(upage) == 0);
 	ASSERT(ofs % PGSIZE == 0);
 
+	// fault-around가 이웃 세그먼트로 넘어가지 않도록 페이지마다 세그먼트 범위를 기록
+	uint8_t *seg_start = upage;
+	uint8_t *seg_end = upage + read_bytes + zero_bytes;
+
 	while (read_bytes > 0 || zero_bytes > 0)
 	{
 		
@@ -890,17 +888,51 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		struct load *aux = malloc(sizeof(struct load));
-		aux->file = file;                    // 참조할 파일
-		aux->ofs = ofs;                      // 이 페이지가 읽을 파일 오프셋
-		aux->read_bytes = page_read_bytes;  // 이 페이지에서 읽을 바이트 수
-		aux->zero_bytes = page_zero_bytes;  // 나머지 zero-fill 바이트 수
-
-		/* lazy loading용 anonymous 페이지 할당.
-		 * 실제 데이터 로딩은 lazy_load_segment가 페이지 폴트 시 수행 */
-		if (!vm_alloc_page_with_initializer(VM_ANON, upage,
-											writable, lazy_load_segment, aux))
-			return false;  // 할당 실패 시 중단
+		if (page_read_bytes == 0)
+		{
+			/* 파일 내용이 없는 페이지(BSS)는 demand-zero 페이지로 할당.
+			 * 폴트 시 0으로 채우기만 하고 파일 시스템은 거치지 않음 */
+			if (!vm_alloc_page_with_initializer(VM_ANON | VM_SEGMENT | VM_ZERO,
+												upage, writable, NULL, NULL))
+				return false;
+		}
+		else if (!writable)
+		{
+			/* 읽기 전용 세그먼트(text, rodata)는 file-backed 페이지로 할당.
+			 * 내용이 실행 파일과 항상 같으므로 교체 시 쓰기 없이 버리고,
+			 * 다시 필요해지면 파일에서 읽어 옴 (file_backed_swap_in) */
+			struct file_load *aux = malloc(sizeof(struct file_load));
+			if (aux == NULL)
+				return false;
+			aux->file = file;                    // 프로세스의 실행 파일을 공유 (process_exit에서 닫힘)
+			aux->ofs = ofs;
+			aux->read_bytes = page_read_bytes;
+			aux->zero_bytes = page_zero_bytes;
+			aux->file_length = 0;                // mmap 영역이 아님 (VM_MMAP 없음)
+			aux->seg_start = seg_start;
+			aux->seg_end = seg_end;
+
+			if (!vm_alloc_page_with_initializer(VM_FILE | VM_SEGMENT, upage,
+												false, file_lazy_load, aux))
+				return false;
+		}
+		else
+		{
+			struct load *aux = malloc(sizeof(struct load));
+			aux->file = file;                    // 참조할 파일
+			aux->ofs = ofs;                      // 이 페이지가 읽을 파일 오프셋
+			aux->read_bytes = page_read_bytes;  // 이 페이지에서 읽을 바이트 수
+			aux->zero_bytes = page_zero_bytes;  // 나머지 zero-fill 바이트 수
+			aux->seg_start = seg_start;          // 이 페이지가 속한 세그먼트 범위
+			aux->seg_end = seg_end;
+
+			/* lazy loading용 anonymous 페이지 할당.
+			 * 실제 데이터 로딩은 lazy_load_segment가 페이지 폴트 시 수행
+			 * (VM_SEGMENT: 폴트 시 주변 세그먼트 페이지도 함께 적재됨) */
+			if (!vm_alloc_page_with_initializer(VM_ANON | VM_SEGMENT, upage,
+												writable, lazy_load_segment, aux))
+				return false;  // 할당 실패 시 중단
+		}
 
 		/* 다음 페이지로 이동 */
 		read_bytes -= page_read_bytes;
@@ -935,7 +967,7 @@ setup_stack(struct intr_frame *if_)
 	void *stack_bottom = (void *)(((uint8_t *)USER_STACK) - PGSIZE);
 
 	/* anonymous 페이지를 스택 하단에 할당 (즉시 사용 예정이므로 lazy X) */
-	if (!vm_alloc_page_with_initializer(VM_ANON, stack_bottom, 1, NULL, NULL))
+	if (!vm_alloc_page_with_initializer(VM_ANON | VM_ZERO, stack_bottom, 1, NULL, NULL))
 		return false;
 
 	/* 즉시 페이지를 확보 (lazy loading이 아니라 바로 물리 프레임 할당) */
@@ -58,7 +58,6 @@ void syscall_init(void)
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			  FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
-	lock_init(&filesys_lock);
 }
 
 /* The main system call interface */
@@ -186,9 +185,7 @@ bool create(const char *file, unsigned initial_size)
 	- initial_size: 생성할 파일 크기
 	*/
 	check_address(file);
-	lock_acquire(&filesys_lock);
 	bool success = filesys_create(file, initial_size);
-	lock_release(&filesys_lock);
 	return success;
 }
 
@@ -200,9 +197,7 @@ bool remove(const char *file)
 	- 성공 일 경우 true, 실패 일 경우 false 리턴
 	*/
 	check_address(file);
-	lock_acquire(&filesys_lock);
 	bool success = filesys_remove(file);
-	lock_release(&filesys_lock);
 	return success;
 }
 
@@ -213,13 +208,11 @@ int open(const char *file)
 {
 	check_address(file);
 	/* 파일을 open */
-	lock_acquire(&filesys_lock);
 	struct file *fileobj = filesys_open(file);
 
 	/* 해당 파일이 존재하지 않으면 -1 리턴 */
 	if (fileobj == NULL)
 	{
-		lock_release(&filesys_lock);
 		return -1;
 	}
 	/* 해당 파일 객체에 파일 디스크립터 부여 */
@@ -230,7 +223,6 @@ int open(const char *file)
 		file_close(fileobj);
 	}
 	/* 파일 디스크립터 리턴 */
-	lock_release(&filesys_lock);
 	return fd;
 }
 
@@ -244,9 +236,7 @@ int filesize(int fd)
 	{
 		return -1;
 	}
-	lock_acquire(&filesys_lock);
 	int length = file_length(open_file);
-	lock_release(&filesys_lock);
 	return length;
 }
 /*
@@ -260,7 +250,6 @@ int read(int fd, void *buffer, unsigned size)
 		exit(-1);
 	off_t read_byte = 0;
 	uint8_t *read_buffer = (char *)buffer;
-	lock_acquire(&filesys_lock);
 	if (fd == 0)
 	{
 		char key;
@@ -276,7 +265,6 @@ int read(int fd, void *buffer, unsigned size)
 	}
 	else if (fd == 1)
 	{
-		lock_release(&filesys_lock);
 		return -1;
 	}
 	else
@@ -284,12 +272,10 @@ int read(int fd, void *buffer, unsigned size)
 		struct file *read_file = process_get_file(fd);
 		if (read_file == NULL)
 		{
-			lock_release(&filesys_lock);
 			return -1;
 		}
 		read_byte = file_read(read_file, buffer, size);
 	}
-	lock_release(&filesys_lock);
 	return read_byte;
 }
 
@@ -301,29 +287,24 @@ int write(int fd, const void *buffer, unsigned size)
 	check_address(buffer);
 	struct file *write_file = process_get_file(fd);
 	int bytes_write;
-	lock_acquire(&filesys_lock);
 	if (fd < 2)
 	{
 		if (fd == 1)
 		{
 			putbuf(buffer, size);
 			bytes_write = size;
-			lock_release(&filesys_lock);
 			return size;
 		}
-		lock_release(&filesys_lock);
 		return -1;
 	}
 	else
 	{
 		if (write_file == NULL)
 		{
-			lock_release(&filesys_lock);
 			return -1;
 		}
 		bytes_write = file_write(write_file, buffer, size);
 	}
-	lock_release(&filesys_lock);
 	return bytes_write;
 }
 
@@ -375,9 +356,7 @@ void close(int fd)
 	{
 		return;
 	}
-	lock_acquire(&filesys_lock);
 	file_close(close_file);
-	lock_release(&filesys_lock);
 	process_close_file(fd);
 }
 
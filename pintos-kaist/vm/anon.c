@@ -1,16 +1,24 @@
+#include <bitmap.h>
 #include "vm/vm.h"
 #include "threads/vaddr.h"
+#include "threads/mmu.h"
+#include "threads/malloc.h"
 #include "devices/disk.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;                  // 스왑 디스크 핸들
-static struct list swap_slot_list;              // 빈 스왑 슬롯 리스트
+static struct bitmap *swap_table;               // 슬롯 사용 여부 (1=사용 중), 첫 swap-out 때 생성
+static size_t swap_hint;                        // next-fit 탐색 시작 위치
 static struct lock swap_lock;                   // 스왑 슬롯 접근 보호 락
-static char *zero_set[PGSIZE];                  // 디스크 클리어용 zero 패턴
+#ifdef SWAP_SCRUB
+static char zero_set[DISK_SECTOR_SIZE];         // 디버그용: 반환된 슬롯을 지우는 zero 패턴
+#endif
 
 static bool anon_swap_in(struct page *page, void *kva);
 static bool anon_swap_out(struct page *page);
 static void anon_destroy(struct page *page);
+static struct swap_slot *swap_slot_alloc(void);
+static void swap_slot_free(struct swap_slot *slot);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
@@ -23,35 +31,71 @@ static const struct page_operations anon_ops = {
 /* 익명 페이지용 초기화 함수
  *
  * [역할]
- * - Swap 영역으로 사용할 디스크를 지정하고,
- *   그 디스크를 SLOT_SIZE 단위로 나누어 swap slot 리스트를 구성
- * - 각 슬롯은 나중에 anonymous 페이지를 swap-out할 때 사용됨
+ * - Swap 영역으로 사용할 디스크를 지정
+ * - 슬롯 비트맵은 실제로 swap-out이 일어날 때 만들어짐 (swap_slot_alloc)
+ *   → 스왑 디스크 크기와 무관하게 부팅 시간/커널 힙 사용량이 일정함
  */
 void vm_anon_init(void)
 {
 	// (1) 스왑 디스크 설정 (디스크 컨트롤러 1번, 디스크 1번)
 	swap_disk = disk_get(1, 1);  // pintos에서는 하드코딩된 디스크 번호 사용
 
-	// (2) swap slot 리스트 및 락 초기화
-	list_init(&swap_slot_list); // 사용 가능한 슬롯을 리스트 형태로 관리
+	// (2) 슬롯 비트맵은 lazy하게 생성, 락 초기화
+	swap_table = NULL;
+	swap_hint = 0;
 	lock_init(&swap_lock);      // swap-in/out 중 동기화 필요
+}
 
-	// (3) 디스크 전체를 SLOT_SIZE(=PGSIZE / DISK_SECTOR_SIZE) 단위로 분할
-	for (int i = 0; i < disk_size(swap_disk); i += SLOT_SIZE)
-	{
-		// 새 swap_slot 구조체 할당 및 초기화
-		struct swap_slot *slot = malloc(sizeof(struct swap_slot));
-		list_init(&slot->page_list);     // 해당 슬롯에 연결된 페이지들 목록
-		slot->start_sector = i;          // 이 슬롯의 시작 섹터 번호
+/* 빈 스왑 슬롯을 하나 할당
+ *
+ * [역할]
+ * - 처음 호출될 때 스왑 디스크를 SLOT_SIZE 단위로 나눈 비트맵 생성
+ * - 직전에 할당한 위치(swap_hint)부터 next-fit으로 탐색, 끝까지 없으면 처음부터 다시 탐색
+ * - 사용 중인 슬롯만 swap_slot 구조체를 가짐 (슬롯을 공유하는 페이지 목록 보관용)
+ */
+static struct swap_slot *swap_slot_alloc(void)
+{
+	size_t idx;
 
-		// 전역 swap_slot_list에 추가
-		list_push_back(&swap_slot_list, &slot->slot_elem);
+	lock_acquire(&swap_lock);
+	if (swap_table == NULL)
+	{
+		if (swap_disk == NULL)
+			PANIC("no swap disk");
+		swap_table = bitmap_create(disk_size(swap_disk) / SLOT_SIZE);
+		if (swap_table == NULL)
+			PANIC("swap bitmap creation failed");
 	}
 
-	// (4) 모든 sector를 0으로 초기화할 수 있는 zero buffer 준비
-	memset(zero_set, 0, PGSIZE); // disk_write 시 zero-fill에 사용
+	idx = bitmap_scan_and_flip(swap_table, swap_hint, 1, false);
+	if (idx == BITMAP_ERROR)
+		idx = bitmap_scan_and_flip(swap_table, 0, 1, false);
+	if (idx == BITMAP_ERROR)
+		PANIC("swap disk is full");
+	swap_hint = idx + 1;
+	lock_release(&swap_lock);
+
+	struct swap_slot *slot = malloc(sizeof(struct swap_slot));
+	if (slot == NULL)
+		PANIC("swap slot allocation failed");
+	slot->start_sector = idx * SLOT_SIZE;
+	list_init(&slot->page_list);     // 해당 슬롯에 연결된 페이지들 목록
+	return slot;
 }
 
+/* 스왑 슬롯을 비트맵에 반환하고 구조체 해제
+ * - SWAP_SCRUB으로 빌드하면 반환 전에 슬롯을 0으로 지움 (디버그 전용, 쓰기 I/O 발생) */
+static void swap_slot_free(struct swap_slot *slot)
+{
+#ifdef SWAP_SCRUB
+	for (int i = 0; i < SLOT_SIZE; i++)
+		disk_write(swap_disk, slot->start_sector + i, zero_set);
+#endif
+	lock_acquire(&swap_lock);
+	bitmap_reset(swap_table, slot->start_sector / SLOT_SIZE);
+	lock_release(&swap_lock);
+	free(slot);
+}
 
 /* 익명 페이지 초기화 함수
  *
@@ -77,20 +121,58 @@ bool anon_initializer(struct page *page, enum vm_type type, void *kva)
 
 	// (5) 프레임의 공유 페이지 리스트에 등록 (나중에 frame->page_list 순회 시 사용됨)
 	list_push_back(&page->frame->page_list, &page->out_elem);
+	page->frame->cnt_page += 1;
 
 	return true;
 }
 
+/* fork 시 부모의 익명 페이지를 자식과 copy-on-write로 공유 (frame_lock을 잡고 호출)
+ *
+ * [역할]
+ * - 부모 페이지가 메모리에 있으면 같은 프레임을 공유하고
+ *   양쪽 모두 읽기 전용으로 매핑 → 첫 쓰기 때 vm_try_handle_fault에서 복사
+ * - 부모 페이지가 스왑 아웃 상태면 같은 swap slot을 공유
+ *   → swap-in 시 두 페이지가 함께 같은 프레임으로 복구됨
+ *
+ * @param child  : 자식 SPT에 이미 등록된 새 페이지 (operations, va, pml4 설정됨)
+ * @param parent : 부모의 익명 페이지
+ */
+void anon_share_page(struct page *child, struct page *parent)
+{
+	struct frame *frame = parent->frame;
+
+	// (1) 스왑 아웃된 상태: 슬롯의 page_list에 함께 등록
+	if (frame == NULL)
+	{
+		child->frame = NULL;
+		child->anon.slot = parent->anon.slot;
+		list_push_back(&child->anon.slot->page_list, &child->out_elem);
+		return;
+	}
+
+	// (2) 메모리에 있는 상태: 프레임 공유 (참조 수 증가)
+	child->anon.slot = NULL;
+	child->frame = frame;
+	list_push_back(&frame->page_list, &child->out_elem);
+	frame->cnt_page += 1;
+
+	// (3) 부모/자식 모두 읽기 전용으로 매핑
+	pml4_set_page(parent->pml4, parent->va, frame->kva, false);
+	pml4_set_page(child->pml4, child->va, frame->kva, false);
+}
+
 
 /* 스왑 디스크에서 데이터를 읽어와 메모리로 복구 (anonymous 페이지 swap-in)
  *
  * [역할]
  * - 스왑 슬롯에 저장된 데이터를 하나의 프레임으로 복구
  * - 이 프레임을 공유하던 모든 페이지에 대해 pml4 매핑 복원
+ *   (둘 이상이 공유 중이면 COW 유지를 위해 읽기 전용으로 매핑)
  * - 스왑 슬롯은 복구 이후 재사용 가능하도록 반환
+ * - frame_lock을 잡고 호출되며, 디스크 읽기 동안에만 락을 놓음
  *
  * @param page : 복구 대상 페이지 (공유 프레임 기준)
- * @param kva  : 매핑할 커널 가상 주소 (unused, frame->kva 사용)
+ * @param kva  : 데이터를 적재할 프레임의 커널 가상 주소
  * @return true if success
  */
 static bool anon_swap_in(struct page *page, void *kva)
@@ -98,36 +180,37 @@ static bool anon_swap_in(struct page *page, void *kva)
 	struct anon_page *anon_page = &page->anon;
 	struct swap_slot *slot = anon_page->slot;
 	struct list *page_list = &slot->page_list;
-	int read = 0;
+	struct frame *frame = page->frame;
 
-	// (1) swap-out 당시 이 프레임을 공유하던 모든 페이지에 대해 복구 수행
+	// (1) swap-out 당시 이 프레임을 공유하던 모든 페이지를 먼저 frame과 연결
+	//     읽는 동안 다른 공유자가 폴트를 내면 같은 슬롯을 또 읽지 않고 vm_frame_wait에서 기다림
 	while (!list_empty(page_list))
 	{
-		// (2) 해당 페이지를 꺼내 pml4에 다시 매핑
 		struct page *in_page = list_entry(list_pop_front(page_list), struct page, out_elem);
-		pml4_set_page(in_page->pml4, in_page->va, page->frame->kva, in_page->writable);
-
-		// (3) 디스크에서 실제 데이터 복구는 단 한 번만 수행 (첫 번째 페이지 기준)
-		if (read++ == 0)
-		{
-			for (int i = 0; i < SLOT_SIZE; i++)
-			{
-				// 디스크로부터 sector 단위로 읽어서 프레임에 로드
-				disk_read(swap_disk, slot->start_sector + i, in_page->va + DISK_SECTOR_SIZE * i);
-
-				// 해당 sector는 zero_set으로 덮어서 "지운다" (중복 쓰기 방지)
-				disk_write(swap_disk, slot->start_sector + i, zero_set + DISK_SECTOR_SIZE * i);
-			}
-		}
-
-		// (4) 복구된 페이지를 다시 frame과 연결
-		in_page->frame = page->frame;
-		page->frame->cnt_page += 1;
-		list_push_back(&page->frame->page_list, &in_page->out_elem);
+		in_page->frame = frame;
+		in_page->anon.slot = NULL;
+		frame->cnt_page += 1;
+		list_push_back(&frame->page_list, &in_page->out_elem);
+	}
+
+	// (2) 디스크에서 실제 데이터 복구는 단 한 번만 수행
+	//     유저 VA는 다른 프로세스의 것일 수 있으므로 반드시 kva로 읽음
+	//     슬롯은 비트맵에서 비워지기만 하고 디스크 내용은 다음 swap-out 때 덮어씀
+	//     한 페이지(SLOT_SIZE 섹터)를 명령 하나로 읽음
+	//     다 읽은 슬롯은 아무 페이지도 가리키지 않으므로 락을 다시 잡기 전에 반환
+	vm_frame_io_begin(frame);
+	disk_read_multiple(swap_disk, slot->start_sector, kva, SLOT_SIZE);
+	swap_slot_free(slot);
+	vm_frame_io_end(frame);
+
+	// (3) 각 페이지를 pml4에 다시 매핑 (혼자 쓰는 경우에만 쓰기 허용)
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *in_page = list_entry(e, struct page, out_elem);
+		pml4_set_page(in_page->pml4, in_page->va, kva,
+					  in_page->writable && frame->cnt_page == 1);
 	}
 
-	// (5) 사용한 swap 슬롯을 다시 swap_slot_list에 반환 (재사용 가능)
-	list_push_back(&swap_slot_list, &slot->slot_elem);
 	return true;
 }
 
@@ -135,43 +218,46 @@ static bool anon_swap_in(struct page *page, void *kva)
 /* 익명 페이지를 스왑 아웃하는 함수
  *
  * [역할]
- * - 현재 프레임을 공유 중인 모든 페이지를 스왑 디스크에 저장
- * - 각 페이지에 대한 매핑(pml4)을 제거하여 메모리에서 제거
+ * - 현재 프레임 내용을 스왑 디스크에 한 번 저장
+ * - 프레임을 공유 중인 모든 페이지의 매핑(pml4)을 제거하여 메모리에서 제거
  * - 저장된 페이지 정보를 해당 스왑 슬롯에 기록
+ * - frame_lock을 잡고 호출되며, 디스크 쓰기 동안에만 락을 놓음
  *
  * @param page : 스왑 아웃 대상 페이지 (공유 프레임 중 하나)
  * @return true if success
  */
 static bool anon_swap_out(struct page *page)
 {
-	struct anon_page *anon_page = &page->anon;
 	struct frame *frame = page->frame;
 
 	// (1) 비어 있는 swap 슬롯을 하나 꺼내 현재 페이지에 할당
-	anon_page->slot = list_entry(list_pop_front(&swap_slot_list), struct swap_slot, slot_elem);
+	struct swap_slot *slot = swap_slot_alloc();
 
-	// (2) 해당 프레임에 연결된 모든 페이지를 순회하며 swap-out
+	// (2) 쓰는 도중 내용이 바뀌지 않도록 공유 중인 모든 페이지의 매핑을 먼저 제거
+	//     이후 이 페이지들의 폴트는 쓰기가 끝날 때까지 vm_frame_wait에서 대기
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *out_page = list_entry(e, struct page, out_elem);
+		pml4_clear_page(out_page->pml4, out_page->va);
+	}
+
+	// (3) 페이지 내용을 스왑 디스크에 한 번에 저장 (kva 기준, 명령 하나로 SLOT_SIZE 섹터)
+	vm_frame_io_begin(frame);
+	disk_write_multiple(swap_disk, slot->start_sector, frame->kva, SLOT_SIZE);
+	vm_frame_io_end(frame);
+
+	// (4) 해당 프레임에 연결된 모든 페이지를 순회하며 swap-out
 	while (!list_empty(&frame->page_list))
 	{
 		struct page *out_page = list_entry(list_pop_front(&frame->page_list), struct page, out_elem);
 
-		// (3) 프레임 참조 수 감소
+		// (5) 프레임 참조 수 감소 및 연결 해제
 		frame->cnt_page -= 1;
+		out_page->frame = NULL;
 
-		// (4) 스왑 슬롯에 해당 페이지 정보 저장
-		list_push_back(&anon_page->slot->page_list, &out_page->out_elem);
-		out_page->anon.slot = anon_page->slot;
-
-		// (5) 페이지 내용을 스왑 디스크에 sector 단위로 저장
-		for (int i = 0; i < SLOT_SIZE; i++)
-		{
-			disk_write(swap_disk,
-					   out_page->anon.slot->start_sector + i,
-					   out_page->va + DISK_SECTOR_SIZE * i);
-		}
-
-		// (6) 현재 프로세스의 pml4에서 이 페이지에 대한 매핑 제거
-		pml4_clear_page(out_page->pml4, out_page->va);
+		// (6) 스왑 슬롯에 해당 페이지 정보 저장
+		list_push_back(&slot->page_list, &out_page->out_elem);
+		out_page->anon.slot = slot;
 	}
 	return true;
 }
@@ -179,16 +265,32 @@ static bool anon_swap_out(struct page *page)
 /* 익명 페이지 제거 (anonymous page destroy)
  *
  * [역할]
- * - 현재 페이지를 참조 중인 프레임의 참조 수(cnt_page)를 1 감소
- * - 스왑 슬롯 반환이나 메모리 해제는 수행하지 않음
+ * - 메모리에 있으면 프레임에서 분리 (마지막 참조면 프레임까지 해제)
+ * - 스왑 아웃 상태면 슬롯의 공유 리스트에서 빠지고,
+ *   더 이상 쓰는 페이지가 없으면 슬롯을 반환
  *
  * @param page : 제거할 익명 페이지
  */
 static void anon_destroy(struct page *page)
 {
 	struct anon_page *anon_page = &page->anon;
+	struct swap_slot *slot;
 
-	// (1) 이 페이지가 연결된 프레임 참조 수 감소
-	//     실제 frame->kva는 다른 페이지가 여전히 참조 중일 수 있으므로 바로 해제하지 않음
-	page->frame->cnt_page -= 1;
+	// 다른 프로세스가 공유 프레임을 내보내거나 읽어 들이는 중이면 끝난 뒤의 상태를 기준으로 정리
+	lock_acquire(&frame_lock);
+	vm_frame_wait(page);
+	slot = anon_page->slot;
+
+	// (1) 메모리에 올라와 있는 경우
+	if (page->frame != NULL)
+		vm_frame_detach(page);
+
+	// (2) 스왑 아웃된 경우
+	else if (slot != NULL)
+	{
+		list_remove(&page->out_elem);
+		if (list_empty(&slot->page_list))
+			swap_slot_free(slot);
+	}
+	lock_release(&frame_lock);
 }
@@ -1,4 +1,6 @@
 #include "vm/vm.h"
+#include <string.h>
+#include "threads/malloc.h"
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
 #include "userprog/process.h"
@@ -48,12 +50,15 @@ bool file_backed_initializer(struct page *page, enum vm_type type, void *kva)
 	file_page->read_bytes = aux->read_bytes;   // 실제 읽을 바이트 수
 	file_page->zero_bytes = aux->zero_bytes;   // 나머지 0으로 채울 바이트 수
 	file_page->file_length = aux->file_length; // 전체 매핑 길이
+	file_page->file_list = NULL;               // swap-out 전에는 복원 목록 없음
+	file_page->mmap = (type & VM_MMAP) != 0;   // 실행 파일 세그먼트 페이지는 munmap 대상이 아님
 
 	// 페이지의 pml4 등록 (현재 스레드와 연결됨)
 	page->pml4 = thread_current()->pml4;
 
 	// 프레임의 page_list에 연결 → 해당 프레임이 여러 페이지와 연결될 수 있음 (mmap 공유)
 	list_push_back(&page->frame->page_list, &page->out_elem);
+	page->frame->cnt_page += 1;
 
 	return true;
 }
@@ -66,6 +71,8 @@ bool file_backed_initializer(struct page *page, enum vm_type type, void *kva)
  * - file-backed 페이지들은 여러 VA에서 mmap으로 공유될 수 있으므로
  *   연결된 다른 페이지들도 함께 프레임에 매핑 복원
  *
+ * frame_lock을 잡고 호출되며, 파일을 읽는 동안에만 락을 놓는다.
+ *
  * @param page 복원할 대상 페이지
  * @param kva  페이지가 매핑될 커널 주소 (frame->kva와 동일)
  * @return     true always (읽기 실패 등은 별도로 처리하지 않음)
@@ -76,34 +83,38 @@ static bool file_backed_swap_in(struct page *page, void *kva)
 	struct list *file_list = file_page->file_list; // 이 프레임을 공유했던 페이지 목록
 	struct frame *frame = page->frame;
 
-	// 파일 시스템 보호를 위해 락 획득
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
-
-	// 실제 파일로부터 데이터를 읽어와 frame에 로드
-	file_read_at(file_page->file,
-	             page->frame->kva,
-	             file_page->read_bytes,
-	             file_page->ofs);
-
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
-
-	// 공유된 다른 가상 페이지들도 이 프레임에 다시 연결
+	// 공유된 다른 가상 페이지들도 먼저 이 프레임에 다시 연결
+	// (읽는 동안 이들이 폴트를 내면 파일을 또 읽지 않고 vm_frame_wait에서 기다림)
 	while (!list_empty(file_list))
 	{
 		struct page *in_page = list_entry(list_pop_front(file_list), struct page, out_elem);
 
 		// 다시 frame에 연결 (page_list에 복원)
+		in_page->frame = frame;
+		in_page->file.file_list = NULL;
+		frame->cnt_page += 1;
 		list_push_back(&frame->page_list, &in_page->out_elem);
-
-		// 해당 페이지를 MMU에 다시 매핑 (VA → frame->kva)
-		pml4_set_page(in_page->pml4, in_page->va, frame->kva, in_page->writable);
 	}
 
 	// file_list는 재사용하지 않으므로 해제
 	free(file_list);
+
+	// 실제 파일로부터 데이터를 읽어와 frame에 로드 (동기화는 inode가 담당)
+	// 교체로 재사용된 프레임에는 이전 내용이 남아 있으므로 나머지는 0으로 채움
+	vm_frame_io_begin(frame);
+	off_t read = file_read_at(file_page->file,
+	                          frame->kva,
+	                          file_page->read_bytes,
+	                          file_page->ofs);
+	memset(frame->kva + read, 0, PGSIZE - read);
+	vm_frame_io_end(frame);
+
+	// 연결된 페이지들을 MMU에 다시 매핑 (VA → frame->kva)
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *in_page = list_entry(e, struct page, out_elem);
+		pml4_set_page(in_page->pml4, in_page->va, frame->kva, in_page->writable);
+	}
 	return true;
 }
 
@@ -115,94 +126,109 @@ static bool file_backed_swap_in(struct page *page, void *kva)
  * - 이후 프레임과 페이지 간 연결 해제
  * - 해당 프레임과 연결된 모든 페이지는 file_list에 저장됨 (swap-in용)
  *
+ * frame_lock을 잡고 호출되며, 파일에 쓰는 동안에만 락을 놓는다.
+ *
  * @param page 현재 swap-out을 유도한 대표 페이지
  * @return true 항상 true 반환
  */
 static bool file_backed_swap_out(struct page *page)
 {
 	struct file_page *file_page = &page->file;
+	struct frame *frame = page->frame;
+	bool dirty = false;
 
 	// 1. 해당 프레임을 공유하는 모든 페이지를 모아둘 리스트 생성
 	struct list *file_list = malloc(sizeof(struct list));
 	list_init(file_list);
-	file_page->file_list = file_list;
 
-	struct frame *frame = page->frame;
+	// 2. 공유 중인 페이지 중 하나라도 dirty인지 확인하며 매핑을 먼저 해제
+	//    (쓰는 도중 내용이 바뀌지 않고, 이후 폴트는 쓰기가 끝날 때까지 대기)
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *out_page = list_entry(e, struct page, out_elem);
+		if (pml4_is_dirty(out_page->pml4, out_page->va))
+			dirty = true;
+		pml4_clear_page(out_page->pml4, out_page->va);
+	}
 
-	// 2. 파일 시스템 동기화를 위한 락 획득
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
+	// 3. dirty한 경우만 파일에 한 번 write-back 수행 (공유 페이지는 모두 같은 파일 영역을 매핑)
+	//    (읽기 전용 실행 파일 페이지는 dirty가 될 수 없으므로 쓰기 없이 버려짐)
+	if (dirty)
+	{
+		vm_frame_io_begin(frame);
+		file_write_at(file_page->file, frame->kva, file_page->read_bytes, file_page->ofs);
+		vm_frame_io_end(frame);
+	}
 
-	// 3. 해당 프레임을 공유 중인 모든 페이지 처리
+	// 4. 공유 리스트(file_list)로 옮김 (swap-in 시 복원용)
+	//    어느 페이지에서 폴트가 나도 복원할 수 있도록 모든 페이지가 같은 리스트를 가리킴
 	while (!list_empty(&frame->page_list))
 	{
 		struct page *out_page = list_entry(list_pop_front(&frame->page_list), struct page, out_elem);
 
-		// dirty 페이지인 경우만 파일에 write-back 수행
-		if (pml4_is_dirty(out_page->pml4, out_page->va))
-		{
-			file_write_at(out_page->file.file,
-			              out_page->frame->kva,
-			              out_page->file.read_bytes,
-			              out_page->file.ofs);
-		}
-
-		// 공유 리스트(file_list)에 추가 (swap-in 시 복원용)
 		list_push_back(file_list, &out_page->out_elem);
-
-		// 해당 가상 주소와 물리 주소의 매핑 해제
-		pml4_clear_page(out_page->pml4, out_page->va);
+		out_page->file.file_list = file_list;
+		frame->cnt_page -= 1;
+		out_page->frame = NULL;
 	}
 
-	// 4. 락 반환
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
-
 	return true;
 }
 
+/* swap-out된 페이지를 공유 복원 목록(file_list)에서 뺌
+ * 목록이 비면 다시 swap-in될 일이 없으므로 목록도 해제 (frame_lock을 잡고 호출) */
+static void file_list_remove(struct page *page)
+{
+	struct list *file_list = page->file.file_list;
+
+	if (page->frame != NULL || file_list == NULL)
+		return;
+	list_remove(&page->out_elem);
+	if (list_empty(file_list))
+		free(file_list);
+	page->file.file_list = NULL;
+}
+
 /* 파일 기반 페이지(file-backed page) 제거 함수
  *
  * [역할]
  * - 해당 페이지가 dirty한 경우 파일에 write-back
- * - 파일 close
  * - 프레임의 참조 수 감소
  * - 필요한 경우 MMU 매핑 해제
+ * - 파일 close
  *
  * 이 함수는 vm_dealloc_page() → destroy() → file_backed_destroy() 순으로 호출된다.
+ * munmap도 이 경로로 페이지를 해제한다.
  */
 static void file_backed_destroy(struct page *page)
 {
 	struct file_page *file_page = &page->file;
+	struct frame *frame;
 
-	// 1. 프레임 참조 카운트 감소 (공유된 프레임이므로 한 페이지 제거 시마다 감소)
-	page->frame->cnt_page -= 1;
-
-	// 2. 파일 동기화를 위한 락 획득 (중첩 락 방지)
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
+	lock_acquire(&frame_lock);
+	vm_frame_wait(page);
+	frame = page->frame;
 
-	// 3. 페이지가 dirty 상태라면 파일에 write-back
-	if (pml4_is_dirty(thread_current()->pml4, page->va))
+	// 1. 메모리에 올라와 있고 dirty 상태라면 파일에 write-back
+	//    쓰는 동안 프레임이 교체되지 않도록 I/O 중으로 표시하고 락을 놓음
+	if (frame != NULL && pml4_is_dirty(page->pml4, page->va))
 	{
-		file_write_at(page->file.file,
-		              page->frame->kva,
-		              page->file.read_bytes,
-		              page->file.ofs);
+		vm_frame_io_begin(frame);
+		file_write_at(file_page->file, frame->kva, file_page->read_bytes, file_page->ofs);
+		vm_frame_io_end(frame);
 	}
 
-	// 4. 해당 페이지가 참조하던 파일 닫기 (ref count 감소)
-	file_close(page->file.file);
+	// 2. swap-out 상태라면 다른 공유 페이지가 복원할 때 참조하지 않도록 목록에서 제거
+	file_list_remove(page);
 
-	// 5. 락 해제
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
+	// 3. 프레임에서 분리 (공유 중이면 매핑만 해제, 마지막 참조면 프레임까지 해제)
+	vm_frame_detach(page);
+	lock_release(&frame_lock);
 
-	// 6. 아직 다른 페이지들이 같은 프레임을 공유 중이면 현재 페이지만 매핑 해제
-	if (page->frame->cnt_page > 0)
-		pml4_clear_page(thread_current()->pml4, page->va);
+	// 4. 해당 페이지가 참조하던 파일 닫기 (ref count 감소)
+	//    실행 파일 세그먼트 페이지는 프로세스의 실행 파일을 빌려 쓰므로 닫지 않음 (process_exit에서 닫힘)
+	if (file_page->mmap)
+		file_close(file_page->file);
 }
 
 
@@ -214,34 +240,23 @@ static void file_backed_destroy(struct page *page)
  * - 페이지 폴트가 발생했을 때 최초로 호출되며,
  *   해당 페이지의 프레임에 실제 내용을 로딩한다.
  */
-static bool lazy_load(struct page *page, void *aux_)
+bool file_lazy_load(struct page *page, void *aux_)
 {
 	// 1. 인자로 전달된 보조 정보 구조체 파싱
 	struct file_load *aux = (struct file_load *)aux_;
 	struct file *file = aux->file;
 	off_t ofs = aux->ofs;					// 파일에서 읽기 시작할 오프셋
 	uint32_t read_bytes = aux->read_bytes; // 읽어야 할 바이트 수
-	uint32_t zero_bytes = aux->zero_bytes; // 남은 공간을 0으로 채울 바이트 수
 
 	free(aux); // aux는 더 이상 필요 없으므로 해제
 
-	// 2. 파일 시스템 락 획득 (다중 스레드 환경에서의 race condition 방지)
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
-
-	// 3. 파일 위치를 오프셋으로 이동
-	file_seek(file, ofs);
-
-	// 4. 파일에서 실제 내용 읽기
-	read_bytes = file_read(file, page->frame->kva, read_bytes);
+	// 2. 파일에서 실제 내용 읽기
+	//    위치를 지정해 읽으므로 같은 file을 공유하는 폴트끼리 file->pos를 두고 경합하지 않음
+	read_bytes = file_read_at(file, page->frame->kva, read_bytes, ofs);
 
-	// 5. 락 해제
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
-
-	// 6. 남은 영역을 0으로 초기화 (zero-fill)
-	memset(page->frame->kva + read_bytes, 0, zero_bytes);
+	// 3. 남은 영역을 0으로 초기화 (zero-fill)
+	//    프레임은 0으로 채워져 오지 않으므로 덜 읽힌 부분까지 페이지 끝까지 채움
+	memset(page->frame->kva + read_bytes, 0, PGSIZE - read_bytes);
 
 	return true;
 }
@@ -251,7 +266,7 @@ static bool lazy_load(struct page *page, void *aux_)
  *
  * [역할]
  * - 파일의 offset부터 length만큼의 데이터를 주소 addr부터 가상 메모리에 매핑
- * - 실제 데이터는 lazy_load() 함수로 지연 로딩됨 (페이지 폴트 발생 시 load)
+ * - 실제 데이터는 file_lazy_load() 함수로 지연 로딩됨 (페이지 폴트 발생 시 load)
  * - 페이지 단위로 매핑하고 이미 존재하는 주소일 경우 실패
  *
  * @param addr      : 매핑할 시작 가상 주소 (유저 스택 영역과 겹치면 안 됨)
@@ -278,12 +293,7 @@ void *do_mmap(void *addr, size_t length, int writable,
 			return NULL;
 	}
 
-	// (2) 파일 시스템 락을 필요 시 획득 (동기화)
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
-
-	// (3) 각 페이지에 대해 lazy loading 방식으로 매핑 등록
+	// (2) 각 페이지에 대해 lazy loading 방식으로 매핑 등록
 	for (int i = 0; i < cnt_page; i++) {
 		// 파일을 reopen해서 각 페이지마다 독립적인 참조 확보
 		struct file *file_ = file_reopen(file);
@@ -306,16 +316,20 @@ void *do_mmap(void *addr, size_t length, int writable,
 		aux->zero_bytes = PGSIZE - aux->read_bytes;
 
 		// lazy loader를 지정하여 VM_FILE 타입으로 페이지 할당
-		vm_alloc_page_with_initializer(VM_FILE, addr + i * PGSIZE, writable, lazy_load, aux);
+		vm_alloc_page_with_initializer(VM_FILE | VM_MMAP, addr + i * PGSIZE, writable, file_lazy_load, aux);
 	}
 
-	// (4) 락 해제
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
-
 	return addr;
 }
 
+/* mmap()으로 매핑된 페이지인지 확인 (아직 적재 전이면 할당 타입의 VM_MMAP 표시로 판단) */
+static bool is_mmap_page(struct page *page)
+{
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+		return (page->uninit.type & VM_MMAP) != 0;
+	return VM_TYPE(page->operations->type) == VM_FILE && page->file.mmap;
+}
+
 /* munmap() 시스템 콜 구현: 주어진 addr부터 시작하는 매핑 해제
  *
  * [역할]
@@ -335,46 +349,30 @@ void do_munmap(void *addr)
 		return;
 
 	// (2) 해당 주소의 페이지를 보조 페이지 테이블에서 찾음
+	//     mmap()으로 매핑한 페이지가 아니면 (실행 파일, 스택 등) 해제하지 않음
 	struct page *page = spt_find_page(&thread_current()->spt, addr);
-	if (page == NULL)
+	if (page == NULL || !is_mmap_page(page))
 		return;
 
 	// (3) mmap된 총 길이와 해제할 페이지 수 계산
-	length = page->file.file_length;
+	//     아직 적재되지 않은 페이지는 file_page 대신 aux에 길이가 들어 있음
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+		length = ((struct file_load *)page->uninit.aux)->file_length;
+	else
+		length = page->file.file_length;
 	cnt_page = length % PGSIZE ? length / PGSIZE + 1 : length / PGSIZE;
 
-	// (4) 파일 시스템 락을 필요 시 획득
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held)
-		lock_acquire(&filesys_lock);
-
-	// (5) 페이지 하나씩 순회하며 해제
+	// (4) 페이지 하나씩 순회하며 해제
 	for (int i = 0; i < cnt_page; i++)
 	{
 		// 현재 해제 대상 페이지
 		page = spt_find_page(&thread_current()->spt, addr + i * PGSIZE);
 
-		// dirty이면 현재 메모리 내용을 파일에 기록
-		if (pml4_is_dirty(thread_current()->pml4, page->va))
-		{
-			file_write_at(page->file.file, page->va, page->file.read_bytes, page->file.ofs);
-		}
-
-		// 프레임 참조 수 감소
-		page->frame->cnt_page -= 1;
-
-		// 파일 핸들 닫기
-		file_close(page->file.file);
-
 		// 보조 페이지 테이블에서 제거
 		hash_delete(&thread_current()->spt.spt_hash, &page->page_elem);
 
-		// 페이지 테이블에서도 해당 매핑 제거
-		pml4_clear_page(thread_current()->pml4, page->va);
+		// dirty면 파일에 기록하고, 프레임에서 분리한 뒤 파일 핸들을 닫음 (file_backed_destroy)
+		vm_dealloc_page(page);
 	}
-
-	// (6) 락을 획득했으면 해제
-	if (!is_lock_held)
-		lock_release(&filesys_lock);
 }
 
@@ -8,6 +8,8 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
@@ -60,6 +62,15 @@ uninit_initialize (struct page *page, void *kva) {
  * 페이지 자체는 호출자에 의해 해제됩니다. */
 static void
 uninit_destroy (struct page *page) {
-	struct uninit_page *uninit UNUSED = &page->uninit;
-	/* TODO: 처리할 작업이 없다면 그냥 return 하세요. */
+	struct uninit_page *uninit = &page->uninit;
+
+	/* 공유 0 프레임이 매핑되어 있으면 걷어냄 (pml4_destroy가 해제하지 않도록) */
+	if (page->pml4 != NULL)
+		pml4_clear_page (page->pml4, page->va);
+
+	/* 한 번도 적재되지 않은 mmap 페이지는 자기 몫의 파일 참조를 닫음
+	   (실행 파일 세그먼트 페이지는 프로세스의 실행 파일을 빌려 쓰므로 닫지 않음) */
+	if ((uninit->type & VM_MMAP) && uninit->aux != NULL)
+		file_close (((struct file_load *) uninit->aux)->file);
+	free (uninit->aux);
 }
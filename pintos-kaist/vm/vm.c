@@ -1,11 +1,45 @@
+#include <string.h>
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
+#include "filesys/inode.h"
 #include "userprog/syscall.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 #include "vm/file.h"
 
+struct lock frame_lock;
+
+/* 프레임의 디스크 I/O(io)가 끝날 때마다 broadcast (frame_lock과 함께 사용) */
+static struct condition frame_io_done;
+
+/* Clock 교체 알고리즘의 바늘. 호출 간에 유지되어 매번 처음부터 탐색하지 않음 */
+static struct list_elem *clock_hand;
+static size_t frame_cnt; /* frame_table에 등록된 프레임 수 (list_size 순회 방지) */
+
+/* dirty 후보를 찾은 뒤 clean 프레임을 더 찾아볼 최대 프레임 수 */
+#define CLOCK_CLEAN_SCAN 16
+
+/* 읽기 전용 실행 파일 페이지 캐시: (inode, 오프셋, 읽을 바이트 수) → 그 내용이 담긴 프레임
+ * - 같은 실행 파일을 실행하는 프로세스들이 코드 페이지를 frame->page_list로 공유
+ * - 프레임이 메모리에 있는 동안만 등록됨 (교체되거나 마지막 페이지가 빠지면 제거)
+ * - 등록된 프레임에는 항상 file-backed 페이지가 하나 이상 붙어 있고, 그 프로세스는 페이지를 모두
+ *   해제한 뒤에야 실행 파일을 닫으므로 inode가 해제되어 같은 주소가 다른 파일에 재사용되는 일이 없음
+ * - 모든 프로세스가 함께 쓰므로 조회, 등록, 제거는 frame_lock을 잡고 수행 */
+static struct hash text_cache;
+
+/* 아직 한 번도 쓰이지 않은 demand-zero 페이지들이 읽기 전용으로 함께 매핑하는 0 프레임
+ * 프레임 테이블에 들어가지 않으므로 교체 대상이 아니며, 첫 쓰기 때 개별 프레임으로 바뀜 */
+static void *zero_kva;
+
+/* fault-around 창의 페이지 수 (2의 거듭제곱)
+ * 실행 파일 세그먼트에서 폴트가 나면 폴트 주소를 포함하는 이 크기의 정렬된 창 안에서
+ * (같은 세그먼트에 속하는) 아직 적재되지 않은 세그먼트 페이지를 함께 적재 */
+#define FAULT_AROUND_PAGES 8
+
+static hash_hash_func text_hash;
+static hash_less_func text_less;
+
 /* 가상 메모리 서브시스템 초기화 함수
  * - 익명 페이지, 파일 기반 페이지 등 각 서브시스템을 초기화
  * - frame_table 리스트도 초기화함 */
@@ -13,11 +47,13 @@ void vm_init(void)
 {
 	vm_anon_init();              // 익명 페이지용 초기화 함수 호출
 	vm_file_init();              // 파일 기반 페이지용 초기화 함수 호출
-#ifdef EFILESYS
-	pagecache_init();            // Project 4에서 사용하는 페이지 캐시 초기화
-#endif
 	register_inspect_intr();    // 디버깅용 인터럽트 등록
 	list_init(&frame_table);    // 프레임 테이블 리스트 초기화
+	lock_init(&frame_lock);     // 프레임 테이블 락
+	cond_init(&frame_io_done);
+	clock_hand = NULL;          // 시계 바늘은 첫 교체 시 테이블 처음부터 시작
+	hash_init(&text_cache, text_hash, text_less, NULL); // 실행 파일 페이지 캐시 초기화
+	zero_kva = palloc_get_page(PAL_ASSERT | PAL_ZERO); // 공유 0 프레임 (해제되지 않음)
 }
 
 /* 주어진 페이지가 어떤 타입인지 반환 (UNINIT인 경우 내부 타입까지 반환)
@@ -36,8 +72,17 @@ enum vm_type page_get_type(struct page *page)
 
 static struct frame *vm_get_victim(void);
 static bool vm_do_claim_page(struct page *page);
+static bool vm_claim_with_frame(struct page *page, struct frame *frame);
+static bool vm_claim_segment(struct page *page, bool may_evict);
+static void text_cache_remove(struct frame *frame);
+static bool vm_fault_around(struct supplemental_page_table *spt, struct page *fault_page);
 static struct frame *vm_evict_frame(void);
+static void frame_pin(struct frame *frame);
+static void frame_unpin(struct frame *frame);
 static bool install_page(void *upage, void *kpage, bool writable);
+static bool is_segment_page(struct page *page);
+static bool is_zero_page(struct page *page);
+static bool vm_map_zero(struct page *page);
 bool hash_page_less(const struct hash_elem *a, const struct hash_elem *b, void *aux);
 unsigned int hash_va(const struct hash_elem *p, void *aux UNUSED);
 void clear_page_hash(struct hash_elem *h, void *aux);
@@ -50,6 +95,8 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
                                     vm_initializer *init, void *aux)
 {
 	ASSERT(VM_TYPE(type) != VM_UNINIT); // UNINIT는 직접 호출 금지
+	// 프레임은 0으로 채워져 오지 않으므로, 초기화 함수가 없는 페이지는 VM_ZERO여야 함
+	ASSERT(init != NULL || (type & VM_ZERO));
 
 	struct supplemental_page_table *spt = &thread_current()->spt;
 	upage = pg_round_down(upage); // PGSIZE로 페이지 정렬 
@@ -109,79 +156,302 @@ void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
 	vm_dealloc_page(page); // destroy() 호출 후 메모리 해제
 }
 
+/* 프레임을 공유하는 페이지 중 하나라도 최근 접근되었는지 확인
+ * - CLEAR가 true면 확인과 동시에 모든 공유 페이지의 accessed 비트를 지움 */
+static bool frame_is_accessed(struct frame *frame, bool clear)
+{
+	bool accessed = false;
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, out_elem);
+		if (pml4_is_accessed(page->pml4, page->va))
+		{
+			accessed = true;
+			if (clear)
+				pml4_set_accessed(page->pml4, page->va, 0);
+		}
+	}
+	return accessed;
+}
+
+/* 프레임을 내보낼 때 디스크 쓰기가 필요한지 확인
+ * - 익명 페이지는 항상 스왑에 기록해야 하므로 dirty로 취급
+ * - 파일 페이지는 공유 페이지 중 하나라도 dirty면 write-back 필요 */
+static bool frame_is_dirty(struct frame *frame)
+{
+	if (VM_TYPE(frame->page->operations->type) == VM_ANON)
+		return true;
+	for (struct list_elem *e = list_begin(&frame->page_list); e != list_end(&frame->page_list); e = list_next(e))
+	{
+		struct page *page = list_entry(e, struct page, out_elem);
+		if (pml4_is_dirty(page->pml4, page->va))
+			return true;
+	}
+	return false;
+}
+
+/* 시계 바늘을 한 칸 전진 (리스트 끝에 도달하면 처음으로 돌아감) */
+static struct list_elem *clock_advance(struct list_elem *e)
+{
+	e = list_next(e);
+	return e == list_end(&frame_table) ? list_begin(&frame_table) : e;
+}
+
+/* 프레임 테이블에서 프레임을 제거
+ * - 시계 바늘이 해당 프레임을 가리키고 있으면 다음 프레임으로 옮김 */
+static void clock_remove(struct frame *frame)
+{
+	if (clock_hand == &frame->frame_elem)
+	{
+		clock_hand = list_next(clock_hand);
+		if (clock_hand == list_end(&frame_table))
+			clock_hand = NULL;
+	}
+	list_remove(&frame->frame_elem);
+	frame_cnt--;
+}
+
 /* 페이지 교체 알고리즘: victim frame 선택
- * - Clock 방식 (accessed 비트 확인 및 unset 반복) */
+ * - Clock 방식: 이전 호출에서 멈춘 위치(clock_hand)부터 이어서 탐색
+ * - 최근 접근된 프레임은 accessed 비트를 지우고 한 번 더 기회를 줌
+ * - 접근되지 않은 프레임 중 clean한 프레임을 우선 선택하고,
+ *   dirty 후보를 찾은 뒤에는 CLOCK_CLEAN_SCAN 칸까지만 clean 프레임을 더 찾아봄
+ * - pin된 프레임(로딩/COW 복사 중)과 아직 페이지가 연결되지 않은 프레임은 건너뜀 */
 static struct frame *vm_get_victim(void)
 {
-	for (struct list_elem *e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e))
+	struct frame *dirty_victim = NULL;
+	int clean_scan = 0;
+
+	if (clock_hand == NULL)
+		clock_hand = list_begin(&frame_table);
+
+	// 한 바퀴 돌면서 accessed 비트를 모두 지웠다면 두 번째 바퀴에서는 반드시 선택됨
+	for (size_t i = 0; i < 2 * frame_cnt; i++)
 	{
-		struct frame *frame = list_entry(e, struct frame, frame_elem);
+		struct frame *frame = list_entry(clock_hand, struct frame, frame_elem);
+		clock_hand = clock_advance(clock_hand);
+
+		if (frame->pin_cnt > 0 || frame->page == NULL)
+			continue;
 
-		// 해당 프레임의 페이지가 최근 접근되지 않았으면 바로 victim으로 선택
-		if (!pml4_is_accessed(frame->page->pml4, frame->page->va)) 
-			return frame;
-		
 		// 최근 접근되었다면 accessed 비트만 초기화하고 다음 기회 부여
-		pml4_set_accessed(frame->page->pml4, frame->page->va, 0); 
+		if (frame_is_accessed(frame, true))
+			continue;
+
+		// 쓰기 없이 버릴 수 있는 프레임이면 바로 선택
+		if (!frame_is_dirty(frame))
+			return frame;
+
+		// dirty 후보는 기억해두고 조금 더 clean 프레임을 찾아봄
+		if (dirty_victim == NULL)
+			dirty_victim = frame;
+		if (++clean_scan >= CLOCK_CLEAN_SCAN)
+			break;
 	}
-	// 모든 페이지가 accessed == true였던 경우: 2바퀴 째에서 선택하게 됨
-	// → 일단 임시로 맨 앞 프레임을 반환
-	return list_entry(list_front(&frame_table), struct frame, frame_elem);
+
+	if (dirty_victim == NULL)
+		PANIC("no evictable frame");
+
+	// 바늘은 선택된 프레임 바로 다음에서 다음 탐색을 시작
+	clock_hand = clock_advance(&dirty_victim->frame_elem);
+	return dirty_victim;
 }
 
-/* 교체할 frame을 선택하고 swap-out까지 수행 (swap_out은 TODO) */
+/* 교체할 frame을 선택하고 swap-out까지 수행
+ * - 디스크 쓰기 동안 frame_lock을 놓으므로 victim은 그 사이 다른 스레드가 고르지 않도록 pin함 */
 static struct frame *vm_evict_frame(void)
 {
 	struct frame *victim = vm_get_victim();
-	// TODO: swap_out(victim->page)
+
+	frame_pin(victim);
+	text_cache_remove(victim); // 내보내는 동안 다른 프로세스가 캐시에서 찾아 연결하지 않도록
+	swap_out(victim->page);
 	return victim;
 }
 
-/* 새로운 프레임을 확보함. 메모리가 부족할 경우 프레임 교체 발생 */
-static struct frame *vm_get_frame(void)
+/* 프레임을 페이지가 연결되지 않은 빈 상태로 만들고 pin함
+ * - 연결되는 페이지마다 cnt_page 증가 */
+static void frame_reset(struct frame *frame)
+{
+	text_cache_remove(frame); // 교체된 프레임이라면 이전 내용은 더 이상 캐시에 없음
+	frame->page = NULL;
+	list_init(&frame->page_list);
+	frame->cnt_page = 0;
+	frame->pin_cnt = 1;
+}
+
+/* 프레임을 교체 대상에서 제외 (중첩 가능, 같은 횟수만큼 frame_unpin 호출) */
+static void frame_pin(struct frame *frame)
+{
+	frame->pin_cnt++;
+}
+
+/* frame_pin 한 번을 되돌림. 다른 경로가 잡은 pin은 그대로 유지됨 */
+static void frame_unpin(struct frame *frame)
+{
+	ASSERT(frame->pin_cnt > 0);
+	frame->pin_cnt--;
+}
+
+/* 유저 풀에서 받은 물리 페이지 KVA를 새 프레임으로 프레임 테이블에 등록 (pin 상태로 반환)
+ * - palloc_get_multiple로 한꺼번에 받은 페이지도 한 장씩 등록하므로 이후 따로 교체/해제됨 */
+static struct frame *frame_new(void *kva)
 {
-	// 프레임 구조체 자체는 항상 먼저 확보
 	struct frame *frame = calloc(1, sizeof(struct frame));
 
-	// 유저 영역용 물리 페이지 1개 확보 (0으로 초기화됨)
-	void *upage = palloc_get_page(PAL_USER | PAL_ZERO); 
+	frame->kva = kva;                                 // 실제 물리 주소 저장
+	list_push_back(&frame_table, &frame->frame_elem); // 프레임 테이블 등록
+	frame_cnt++;
+	frame_reset(frame);
+	return frame;
+}
+
+/* 교체 없이 빈 유저 페이지로 새 프레임을 확보함
+ * - 유저 풀이 비어 있으면 NULL 반환 (fault-around처럼 급하지 않은 적재용)
+ * - 반환된 프레임은 pin 상태, frame_lock을 잡고 호출 */
+static struct frame *vm_get_free_frame(void)
+{
+	// 유저 영역용 물리 페이지 1개 확보
+	// 0으로 채우지 않음: 적재 경로가 페이지 전체를 덮어쓰고, VM_ZERO 페이지만 claim 시 채움
+	void *upage = palloc_get_page(PAL_USER);
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
 
 	if (upage == NULL)
-	{
-		// 메모리가 부족해서 할당 실패 시:
-		// 1. frame 구조체는 해제
-		free(frame);
+		return NULL;
+	return frame_new(upage);
+}
 
-		// 2. victim frame을 교체 정책으로 선정
-		frame = vm_evict_frame();             // 교체 대상 선정
-		swap_out(frame->page);                // 해당 프레임의 페이지를 디스크로 내보냄
+/* 새로운 프레임을 확보함. 메모리가 부족할 경우 프레임 교체 발생
+ * - 반환된 프레임은 pin 상태이므로, 호출자가 페이지 연결을 마친 뒤 pin을 풀어야 함
+ * - frame_lock을 잡고 호출. 교체 중 디스크 쓰기 동안에는 락이 잠시 풀림 */
+static struct frame *vm_get_frame(void)
+{
+	struct frame *frame = vm_get_free_frame();
 
-		// 3. 프레임 리스트에서 제거 후 다시 추가 (순서 재정의 목적)
-		list_remove(&frame->frame_elem);
-		list_push_back(&frame_table, &frame->frame_elem);
+	if (frame == NULL)
+	{
+		// 메모리가 부족하면 victim frame을 교체 정책으로 선정해 내보냄
+		frame = vm_evict_frame();
 
-		// 4. 이 프레임은 재사용될 것이므로 기존 페이지 링크 해제
-		frame->page = NULL;
+		// 프레임은 테이블 내 위치 그대로 재사용 (시계 바늘은 이미 다음 프레임을 가리킴)
+		frame_reset(frame);
 	}
-	else
+	return frame;
+}
+
+/* PAGE가 연결된 프레임이 디스크 I/O 중이면 끝날 때까지 대기 (frame_lock을 잡고 호출)
+ * - 내보내는 중이었다면 돌아왔을 때 page->frame은 NULL,
+ *   공유 슬롯에서 다른 프로세스가 읽어 들이는 중이었다면 이미 매핑까지 끝나 있음 */
+void vm_frame_wait(struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	while (page->frame != NULL && page->frame->io)
+		cond_wait(&frame_io_done, &frame_lock);
+}
+
+/* FRAME의 디스크 I/O를 시작하며 frame_lock을 놓음
+ * - I/O 동안 FRAME은 pin되어 교체되지 않고, 연결된 페이지의 폴트/해제는 vm_frame_wait에서 대기
+ * - 따라서 I/O 중에는 FRAME의 page_list가 바뀌지 않음 */
+void vm_frame_io_begin(struct frame *frame)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	ASSERT(!frame->io);
+
+	frame->io = true;
+	frame_pin(frame);
+	lock_release(&frame_lock);
+}
+
+/* vm_frame_io_begin으로 시작한 I/O를 끝내고 frame_lock을 다시 잡음 */
+void vm_frame_io_end(struct frame *frame)
+{
+	lock_acquire(&frame_lock);
+	frame->io = false;
+	frame_unpin(frame);
+	cond_broadcast(&frame_io_done, &frame_lock);
+}
+
+/* 페이지를 현재 연결된 프레임에서 분리
+ * - 프레임의 공유 페이지 리스트에서 제거하고 MMU 매핑 해제
+ * - 마지막 참조였다면 물리 페이지와 frame 구조체까지 해제
+ *   (pml4_destroy가 공유 프레임을 중복 해제하지 않도록 매핑은 항상 지움)
+ * - frame_lock을 잡고 호출 */
+void vm_frame_detach(struct page *page)
+{
+	struct frame *frame = page->frame;
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	if (frame == NULL)
+		return;
+	ASSERT(!frame->io);
+
+	list_remove(&page->out_elem);
+	frame->cnt_page -= 1;
+	page->frame = NULL;
+	pml4_clear_page(page->pml4, page->va);
+
+	// 대표 페이지가 빠졌다면 남은 공유 페이지 중 하나로 교체
+	if (frame->page == page)
+		frame->page = list_empty(&frame->page_list)
+						  ? NULL
+						  : list_entry(list_front(&frame->page_list), struct page, out_elem);
+
+	// 마지막 페이지가 빠지면 파일 참조도 사라지므로 pin 여부와 관계없이 캐시에서는 바로 제거
+	if (frame->cnt_page == 0)
+		text_cache_remove(frame);
+	if (frame->cnt_page == 0 && frame->pin_cnt == 0)
 	{
-		// 페이지 확보 성공 시:
-		frame->kva = upage;                   // 실제 물리 주소 저장
-		frame->page = NULL;                   // 아직 연결된 페이지 없음
-		list_push_back(&frame_table, &frame->frame_elem); // 프레임 테이블 등록
+		clock_remove(frame);
+		palloc_free_page(frame->kva);
+		free(frame);
+	}
+}
 
-		list_init(&frame->page_list);         // 공유하는 페이지 리스트 초기화
-		frame->cnt_page = 1;                  // 현재는 페이지 1개만 연결
+/* COW 쓰기 보호 폴트 처리
+ * - 쓰기 가능한 익명 페이지가 fork 이후 읽기 전용으로 공유되고 있을 때 호출됨
+ * - 혼자 쓰는 프레임이면 쓰기 권한만 복구, 공유 중이면 새 프레임에 복사 후 분리
+ * - frame_lock을 잡고 호출. 새 프레임을 얻느라 락이 풀려도 원본은 pin되어 그대로 남음 */
+static bool vm_handle_wp(struct page *page)
+{
+	struct frame *old = page->frame;
+	struct frame *frame;
+
+	if (old == NULL || VM_TYPE(page->operations->type) != VM_ANON)
+		return false;
+
+	// (1) 다른 공유자가 모두 사라졌다면 복사 없이 쓰기 권한만 복구
+	if (old->cnt_page == 1)
+	{
+		pml4_clear_page(page->pml4, page->va);
+		return pml4_set_page(page->pml4, page->va, old->kva, true);
 	}
-	return frame;
+
+	// (2) 새 프레임 확보 (복사 원본이 그 사이 교체되지 않도록 pin)
+	//     원본은 다른 공유자가 적재 중이라 이미 pin되어 있을 수 있으므로 한 번만 더했다가 되돌림
+	frame_pin(old);
+	frame = vm_get_frame();
+	memcpy(frame->kva, old->kva, PGSIZE);
+	frame_unpin(old);
+
+	// (3) 기존 공유 프레임에서 분리하고 새 프레임에 단독으로 연결
+	vm_frame_detach(page);
+	frame->page = page;
+	page->frame = frame;
+	list_push_back(&frame->page_list, &page->out_elem);
+	frame->cnt_page += 1;
+	frame_unpin(frame);
+
+	return pml4_set_page(page->pml4, page->va, frame->kva, true);
 }
 
 /* 유저 스택 확장용 함수
- * - 접근한 주소를 기준으로 anonymous 페이지 할당 및 claim */
+ * - 접근한 주소에 demand-zero 익명 페이지를 등록 (이미 있으면 아무것도 하지 않음)
+ * - 실제 프레임은 이어지는 폴트 처리에서 결정됨: 읽기면 0 프레임, 쓰기면 새 프레임 */
 static void vm_stack_growth(void *addr UNUSED)
 {
-	vm_alloc_page_with_initializer(VM_ANON, pg_round_down(addr), 1, NULL, NULL);
-	vm_claim_page(pg_round_down(addr));
+	vm_alloc_page_with_initializer(VM_ANON | VM_ZERO, pg_round_down(addr), 1, NULL, NULL);
 }
 
 /* 페이지 폴트 핸들러
@@ -190,11 +460,14 @@ static void vm_stack_growth(void *addr UNUSED)
  *     → 스택 자동 확장 or lazy loading 처리
  * - ② 페이지는 존재하지만 protection fault (not_present = false):
  *     → 예: read-only 페이지에 write 요청 → 즉시 종료
+ * - SPT 검사는 이 프로세스만의 일이므로 락 없이, 프레임을 다루는 부분은 frame_lock을 잡고 수행
+ *   (exit()은 페이지 해제 때 frame_lock을 잡으므로 락을 잡기 전에 판단)
  */
 bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write, bool not_present)
 {
 	struct supplemental_page_table *spt = &thread_current()->spt;
 	struct page *page = NULL;
+	bool success;
 	// 현재 커널/유저 모드에 따라 올바른 RSP를 선택
 	uint64_t user_rsp = user ? f->rsp : thread_current()->user_rsp;
 
@@ -203,10 +476,7 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 		// [1] Stack growth: 접근 주소가 RSP 아래거나, 전체 스택 범위 내이면 자동 확장 허용
 		if (user_rsp - 8 == addr ||
 			(USER_STACK - (1 << 20) <= user_rsp && user_rsp < addr && addr < USER_STACK))
-		{
 			vm_stack_growth(addr);
-			return true;
-		}
 
 		// [2] Lazy loading: SPT에서 해당 주소에 등록된 페이지가 있는지 확인
 		page = spt_find_page(spt, pg_round_down(addr));
@@ -217,12 +487,414 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 	}
 	else if (write)
 	{
-		// Protection fault: 존재하는 페이지지만 쓰기 허용되지 않은 경우 → 종료
-		exit(-1);
+		// Protection fault: 쓰기 가능한 페이지라면 COW 공유 중인 것이므로 여기서 분리
+		page = spt_find_page(spt, pg_round_down(addr));
+		if (page == NULL || !page->writable)
+			exit(-1);
+	}
+	else
+		return false;
+
+	lock_acquire(&frame_lock);
+
+	// 다른 프로세스가 이 페이지가 붙은 프레임을 내보내거나 (공유 슬롯에서) 읽어 들이는 중이면 대기
+	vm_frame_wait(page);
+
+	if (page->frame != NULL)
+		// 메모리에 있음: 쓰기 보호 폴트면 COW 분리, 아니면 기다리는 동안 공유자가 함께 적재함
+		success = not_present || vm_handle_wp(page);
+	else if (is_zero_page(page))
+		// 한 번도 쓰이지 않은 demand-zero 페이지
+		// 읽기면 프레임 없이 0 프레임을 공유, 첫 쓰기면 이제서야 프레임을 할당
+		success = write ? vm_do_claim_page(page) : vm_map_zero(page);
+	else if (!is_segment_page(page))
+		// 정상적인 페이지 접근 → 물리 메모리에 매핑 시도 (lazy load 또는 swap-in)
+		success = vm_do_claim_page(page);
+	else
+		// 실행 파일 세그먼트라면 이웃 페이지도 함께 적재해 이후 폴트를 줄임
+		success = vm_fault_around(spt, page);
+
+	lock_release(&frame_lock);
+	return success;
+}
+
+/* 아직 적재되지 않은 실행 파일 세그먼트 페이지인지 확인 */
+static bool is_segment_page(struct page *page)
+{
+	return VM_TYPE(page->operations->type) == VM_UNINIT && (page->uninit.type & VM_SEGMENT);
+}
+
+/* 아직 프레임을 받지 않은 demand-zero 페이지인지 확인 */
+static bool is_zero_page(struct page *page)
+{
+	return VM_TYPE(page->operations->type) == VM_UNINIT && (page->uninit.type & VM_ZERO);
+}
+
+/* demand-zero 페이지 PAGE에 공유 0 프레임을 읽기 전용으로 매핑
+ * - page->pml4는 UNINIT 페이지에서 0 프레임 매핑 여부 표시로도 쓰임
+ *   (claim 또는 uninit_destroy 시 이 매핑을 걷어냄) */
+static bool vm_map_zero(struct page *page)
+{
+	if (page->pml4 != NULL)
+		return true;
+	page->pml4 = thread_current()->pml4;
+	return pml4_set_page(page->pml4, page->va, zero_kva, false);
+}
+
+/* 읽기 전용 세그먼트 페이지 PAGE의 캐시 키를 KEY에 채움
+ * - 쓰기 가능한 페이지는 프로세스마다 내용이 달라지므로 캐시하지 않음 (false 반환)
+ * - 같은 파일 페이지라도 세그먼트 끝에서는 0으로 채우는 영역이 다를 수 있어 읽을 바이트 수까지 키에 포함
+ * - 아직 적재 전이면 aux에서, 방금 초기화된 페이지(vm_read_run)면 file_page에서 읽음 */
+static bool text_cache_key(struct page *page, struct frame *key)
+{
+	// 읽기 전용 세그먼트 페이지만 캐시 대상이며, 이들은 모두 VM_FILE로 할당됨
+	if (page->writable || page_get_type(page) != VM_FILE)
+		return false;
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+	{
+		struct file_load *aux = page->uninit.aux;
+		key->text_inode = file_get_inode(aux->file);
+		key->text_ofs = aux->ofs;
+		key->text_read_bytes = aux->read_bytes;
+	}
+	else
+	{
+		key->text_inode = file_get_inode(page->file.file);
+		key->text_ofs = page->file.ofs;
+		key->text_read_bytes = page->file.read_bytes;
+	}
+	return true;
+}
+
+/* KEY와 같은 내용이 담긴 캐시된 프레임을 찾음 (없으면 NULL) */
+static struct frame *text_cache_find(struct frame *key)
+{
+	struct hash_elem *e;
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	e = hash_find(&text_cache, &key->text_elem);
+	return e != NULL ? hash_entry(e, struct frame, text_elem) : NULL;
+}
+
+/* 내용을 다 읽어 들인 프레임 FRAME을 KEY로 캐시에 등록
+ * - 읽는 동안 frame_lock이 풀려 있었으므로, 그 사이 다른 프로세스가 같은 페이지를 읽어
+ *   먼저 등록했을 수 있음. 그 경우 이 프레임은 등록하지 않고 각자의 프레임을 그대로 씀 */
+static void text_cache_insert(struct frame *frame, struct frame *key)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	frame->text_inode = key->text_inode;
+	frame->text_ofs = key->text_ofs;
+	frame->text_read_bytes = key->text_read_bytes;
+	if (hash_insert(&text_cache, &frame->text_elem) != NULL)
+		frame->text_inode = NULL;
+}
+
+/* 프레임이 캐시에 등록되어 있다면 제거 */
+static void text_cache_remove(struct frame *frame)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	if (frame->text_inode == NULL)
+		return;
+	hash_delete(&text_cache, &frame->text_elem);
+	frame->text_inode = NULL;
+}
+
+/* 아직 적재되지 않은 세그먼트 페이지 PAGE를 이미 메모리에 있는 프레임 FRAME에 연결
+ * - 파일을 읽지 않고 타입별 초기화(page_initializer)만 수행한 뒤 읽기 전용으로 매핑
+ * - page_initializer가 FRAME의 page_list와 cnt_page를 바꾸므로 frame_lock을 잡고 호출
+ *   (캐시에서 찾은 뒤 락을 놓지 않아야 그 사이 프레임이 교체되지 않음) */
+static bool text_cache_attach(struct page *page, struct frame *frame)
+{
+	struct uninit_page *uninit = &page->uninit;
+	void *aux = uninit->aux;
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	page->frame = frame;
+	if (!uninit->page_initializer(page, uninit->type, frame->kva))
+		return false;
+	free(aux); // lazy_load_segment가 호출되지 않으므로 여기서 해제
+	return pml4_set_page(page->pml4, page->va, frame->kva, false);
+}
+
+/* 세그먼트 페이지의 파일 적재 정보
+ * aux 타입이 익명(struct load)/파일(struct file_load) 세그먼트 페이지마다 달라 한 형태로 모음 */
+struct seg_load
+{
+	struct file *file;
+	off_t ofs;
+	uint32_t read_bytes;
+	uint8_t *start, *end; /* 페이지가 속한 세그먼트의 범위 [start, end) */
+};
+
+/* 아직 적재되지 않은 세그먼트 페이지 PAGE의 적재 정보를 INFO에 채움
+ * - 파일에서 읽을 내용이 없는 demand-zero 페이지(BSS)는 aux가 없으므로 false */
+static bool seg_load_get(struct page *page, struct seg_load *info)
+{
+	if (is_zero_page(page) || page->uninit.aux == NULL)
+		return false;
+	if (VM_TYPE(page->uninit.type) == VM_FILE)
+	{
+		struct file_load *aux = page->uninit.aux;
+		*info = (struct seg_load){aux->file, aux->ofs, aux->read_bytes, aux->seg_start, aux->seg_end};
+	}
+	else
+	{
+		struct load *aux = page->uninit.aux;
+		*info = (struct seg_load){aux->file, aux->ofs, aux->read_bytes, aux->seg_start, aux->seg_end};
+	}
+	return true;
+}
+
+/* 연속 읽기에 넣을 수 있는 페이지인지 확인
+ * - 아직 적재되지 않았고, 파일에서 읽을 내용이 있으며, 같은 내용이 텍스트 캐시에 없어야 함 */
+static bool segment_readable(struct page *page)
+{
+	struct frame key;
+
+	if (page == NULL || !is_segment_page(page) || is_zero_page(page))
+		return false;
+	return !text_cache_key(page, &key) || text_cache_find(&key) == NULL;
+}
+
+/* PAGE가 PREV 바로 뒤의 파일 내용을 담는지 확인 (둘 다 segment_readable)
+ * - PREV가 한 페이지를 꽉 채워 읽어야 PAGE의 파일 위치가 바로 이어짐 */
+static bool segment_follows(struct page *prev, struct page *page)
+{
+	struct seg_load a, b;
+
+	if (!segment_readable(prev) || !segment_readable(page))
+		return false;
+	seg_load_get(prev, &a);
+	seg_load_get(page, &b);
+	return a.file == b.file && a.read_bytes == PGSIZE && b.ofs == a.ofs + PGSIZE;
+}
+
+/* VA부터 HI 전까지 VA의 페이지와 파일 위치가 이어지는 페이지들을 RUN에 모으고 개수를 반환 */
+static int segment_run(struct supplemental_page_table *spt, uint8_t *va, uint8_t *hi, struct page **run)
+{
+	int n = 0;
+
+	run[n++] = spt_find_page(spt, va);
+	for (va += PGSIZE; va < hi; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+		if (!segment_follows(run[n - 1], page))
+			break;
+		run[n++] = page;
+	}
+	return n;
+}
+
+/* vm_read_run이 되돌릴 수 있도록 보관하는, 초기화가 덮어쓰는 페이지 필드 */
+struct run_saved
+{
+	const struct page_operations *operations;
+	uint64_t *pml4;
+	struct uninit_page uninit;
+};
+
+/* vm_read_run이 적재하던 RUN의 N개 페이지를 적재 전 상태(SAVED)로 되돌리고 FRAMES를 해제
+ * - 앞의 MAPPED개 페이지는 매핑까지 끝났으므로 매핑도 걷어냄
+ * - aux는 모두 성공한 뒤에만 해제하므로 되돌린 페이지는 다음 폴트에서 다시 적재할 수 있음 */
+static void vm_read_run_undo(struct page **run, struct frame **frames, struct run_saved *saved, int n, int mapped)
+{
+	for (int i = 0; i < n; i++)
+	{
+		struct frame *frame = frames[i];
+
+		if (i < mapped)
+			pml4_clear_page(run[i]->pml4, run[i]->va);
+		run[i]->operations = saved[i].operations;
+		run[i]->pml4 = saved[i].pml4;
+		run[i]->uninit = saved[i].uninit;
+		run[i]->frame = NULL;
+
+		clock_remove(frame);
+		palloc_free_page(frame->kva);
+		free(frame);
+	}
+	cond_broadcast(&frame_io_done, &frame_lock);
+}
+
+/* vm_read_run의 결과 */
+enum run_result
+{
+	RUN_LOADED,    /* 모두 적재됨 */
+	RUN_NO_FRAMES, /* 연속된 빈 물리 페이지가 없어 아무것도 하지 않음 */
+	RUN_FAILED,    /* 초기화나 매핑에 실패해 적재 전 상태로 되돌림 */
+};
+
+/* RUN의 N개 세그먼트 페이지를 연속된 빈 물리 페이지에 적재 (frame_lock을 잡고 호출)
+ * - 페이지마다 lazy_load_segment/file_lazy_load를 부르는 대신 file_read_at 한 번으로 모두 읽음
+ * - 교체 없이 연속된 N 페이지를 얻지 못하면 아무것도 하지 않고 RUN_NO_FRAMES
+ * - 초기화나 매핑에 실패하면 모든 페이지를 적재 전 상태로 되돌리고 RUN_FAILED
+ * - 읽는 동안에는 락을 놓음: 프레임은 io로 표시되고 pin되어 있으며, 이 프로세스의 페이지만 붙어 있음
+ *   (텍스트 캐시에는 다 읽은 뒤에 등록) */
+static enum run_result vm_read_run(struct page **run, int n)
+{
+	struct frame *frames[FAULT_AROUND_PAGES];
+	struct run_saved saved[FAULT_AROUND_PAGES];
+	struct seg_load first, last;
+	struct frame key;
+	uint8_t *kva;
+	off_t size, read;
+
+	ASSERT(n <= FAULT_AROUND_PAGES);
+	kva = palloc_get_multiple(PAL_USER, n);
+	if (kva == NULL)
+		return RUN_NO_FRAMES;
+
+	seg_load_get(run[0], &first);
+	seg_load_get(run[n - 1], &last);
+	size = (off_t)(n - 1) * PGSIZE + last.read_bytes;
+
+	// (1) 각 페이지를 자기 프레임에 연결하고 타입별 초기화
+	//     실패하면 되돌릴 수 있도록 초기화가 덮어쓰는 필드를 먼저 보관
+	for (int i = 0; i < n; i++)
+	{
+		struct uninit_page *uninit = &run[i]->uninit;
+
+		saved[i].operations = run[i]->operations;
+		saved[i].pml4 = run[i]->pml4;
+		saved[i].uninit = *uninit;
+
+		frames[i] = frame_new(kva + i * PGSIZE);
+		frames[i]->page = run[i];
+		frames[i]->io = true;
+		run[i]->frame = frames[i];
+		if (!uninit->page_initializer(run[i], uninit->type, frames[i]->kva))
+		{
+			vm_read_run_undo(run, frames, saved, i + 1, 0);
+			return RUN_FAILED;
+		}
+	}
+
+	// (2) 파일 내용을 한 번에 읽고, 마지막 페이지의 남은 부분(또는 덜 읽힌 부분)을 0으로 채움
+	lock_release(&frame_lock);
+	read = file_read_at(first.file, kva, size, first.ofs);
+	memset(kva + read, 0, (size_t)n * PGSIZE - read);
+	lock_acquire(&frame_lock);
+
+	// (3) 모두 매핑한 뒤에야 되돌릴 일이 없으므로 aux를 해제하고,
+	//     읽기 전용 페이지는 캐시에 등록한 뒤 교체 대상에 포함
+	for (int i = 0; i < n; i++)
+		if (!install_page(run[i]->va, frames[i]->kva, run[i]->writable))
+		{
+			vm_read_run_undo(run, frames, saved, n, i);
+			return RUN_FAILED;
+		}
+	for (int i = 0; i < n; i++)
+	{
+		free(saved[i].uninit.aux);
+		if (text_cache_key(run[i], &key))
+			text_cache_insert(frames[i], &key);
+		frames[i]->io = false;
+		frame_unpin(frames[i]);
 	}
+	cond_broadcast(&frame_io_done, &frame_lock);
+	return RUN_LOADED;
+}
 
-	// 정상적인 페이지 접근 → 물리 메모리에 매핑 시도 (lazy load 수행)
-	return vm_do_claim_page(page);
+/* 실행 파일 세그먼트 페이지 FAULT_PAGE를 주변 페이지와 함께 적재 (fault-around, frame_lock을 잡고 호출)
+ * - FAULT_PAGE를 포함하는 FAULT_AROUND_PAGES 크기의 정렬된 창을 FAULT_PAGE의 세그먼트 범위로 잘라 사용
+ * - 창 안에서 파일 위치가 이어지는 페이지들은 연속된 프레임에 한 번에 읽음 (vm_read_run)
+ * - 폴트 페이지가 속한 구간부터 읽고, 연속 프레임을 얻지 못하면 폴트 페이지만 교체를 허용해 적재
+ *   (초기화나 매핑에 실패하면 false: 폴트를 낸 프로세스가 종료됨)
+ * - 나머지 페이지는 교체 없이 얻을 수 있는 빈 프레임만 사용: 메모리가 부족하면 미리 적재를 멈춤
+ *   (쓰일지 모르는 페이지를 위해 다른 페이지를 내보내지 않음) */
+static bool vm_fault_around(struct supplemental_page_table *spt, struct page *fault_page)
+{
+	struct page *run[FAULT_AROUND_PAGES];
+	struct seg_load seg;
+	uint8_t *lo, *hi, *va;
+	int n;
+
+	// demand-zero 페이지는 vm_try_handle_fault가 따로 처리하므로 FAULT_PAGE에는 항상 aux가 있음
+	seg_load_get(fault_page, &seg);
+	lo = (uint8_t *)((uint64_t)fault_page->va & ~((uint64_t)FAULT_AROUND_PAGES * PGSIZE - 1));
+	hi = lo + FAULT_AROUND_PAGES * PGSIZE;
+	if (lo < seg.start)
+		lo = seg.start;
+	if (hi > seg.end)
+		hi = seg.end;
+
+	// (1) 폴트 페이지부터 적재: 캐시에 같은 내용이 있으면 공유하고,
+	//     아니면 파일 위치가 이어지는 앞쪽 페이지부터 폴트 페이지가 속한 구간을 한 번에 읽음
+	if (!segment_readable(fault_page))
+	{
+		if (!vm_claim_segment(fault_page, true))
+			return false;
+	}
+	else
+	{
+		va = fault_page->va;
+		while (va > lo && segment_follows(spt_find_page(spt, va - PGSIZE), spt_find_page(spt, va)))
+			va -= PGSIZE;
+		n = segment_run(spt, va, hi, run);
+		switch (vm_read_run(run, n))
+		{
+		case RUN_LOADED:
+			break;
+		case RUN_NO_FRAMES:
+			if (!vm_claim_segment(fault_page, true))
+				return false;
+			break;
+		case RUN_FAILED:
+			return false;
+		}
+	}
+
+	// (2) 창의 나머지 페이지는 빈 프레임이 있을 때만 미리 적재
+	for (va = lo; va < hi; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+
+		if (page == NULL || !is_segment_page(page))
+			continue;
+		// BSS 페이지는 프레임 대신 0 프레임만 매핑 (첫 쓰기 때 할당)
+		if (is_zero_page(page))
+		{
+			vm_map_zero(page);
+			continue;
+		}
+		// 캐시에 같은 내용이 있으면 파일을 읽지 않고 공유
+		if (!segment_readable(page))
+		{
+			if (!vm_claim_segment(page, false))
+				return true;
+			continue;
+		}
+		// 미리 적재하던 페이지가 실패하면 되돌려 두고 멈춤 (실제로 접근할 때 다시 적재)
+		n = segment_run(spt, va, hi, run);
+		if (vm_read_run(run, n) != RUN_LOADED)
+			return true;
+		va += (n - 1) * PGSIZE;
+	}
+	return true;
+}
+
+/* 실행 파일 세그먼트 페이지 PAGE를 적재 (frame_lock을 잡고 호출)
+ * - 읽기 전용이고 같은 내용의 프레임이 이미 메모리에 있으면 파일을 읽지 않고 공유
+ * - 아니면 새 프레임에 읽어 들이고, 읽기 전용이면 캐시에 등록
+ *   (조회와 등록 사이 파일을 읽는 동안에는 락이 풀림)
+ * - MAY_EVICT가 false면 빈 프레임이 없을 때 교체하지 않고 실패 */
+static bool vm_claim_segment(struct page *page, bool may_evict)
+{
+	struct frame key;
+	struct frame *frame;
+	bool cacheable = text_cache_key(page, &key);
+
+	if (cacheable && (frame = text_cache_find(&key)) != NULL)
+		return text_cache_attach(page, frame);
+
+	frame = may_evict ? vm_get_frame() : vm_get_free_frame();
+	if (frame == NULL || !vm_claim_with_frame(page, frame))
+		return false;
+	if (cacheable)
+		text_cache_insert(frame, &key);
+	return true;
 }
 
 /* 페이지를 실제로 확보(claim)하여 물리 메모리에 연결하는 함수
@@ -235,25 +907,39 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
  *   - ANON / FILE: swap-in에 모든 역할 위임
  * - 마지막으로 swap_in() 호출하여 실제 데이터 메모리에 적재
  *
+ * - frame_lock을 잡고 호출 (교체나 적재의 디스크 I/O 동안에는 잠시 풀림)
+ *
  * @param page  확보할 가상 페이지 구조체
  * @return true on success, false on failure
  */
 static bool vm_do_claim_page(struct page *page)
 {
 	// 1. 새로운 유저 프레임을 확보
-	struct frame *frame = vm_get_frame();
+	return vm_claim_with_frame(page, vm_get_frame());
+}
 
+/* 이미 확보한 (pin된) 프레임 FRAME에 페이지를 적재 (vm_do_claim_page의 2~5단계) */
+static bool vm_claim_with_frame(struct page *page, struct frame *frame)
+{
 	// 2. 페이지 <-> 프레임 연결
 	frame->page = page;
 	page->frame = frame;
 
 	// 3. 페이지 타입별로 처리 분기
+	bool success;
 	switch (VM_TYPE(page->operations->type))
 	{
 	case VM_UNINIT:
+		// 0 프레임을 읽기 전용으로 매핑해 두었다면 먼저 걷어냄
+		if (page->pml4 != NULL)
+			pml4_clear_page(page->pml4, page->va);
 		// Lazy loading용 페이지는 먼저 MMU에 가상-물리 매핑이 필요함
 		if (!install_page(page->va, frame->kva, page->writable))
 			PANIC("FAIL");  // 매핑 실패는 심각한 오류로 간주
+		// demand-zero 페이지는 읽어 올 내용이 없으므로 0으로 채우기만 함
+		// (page_initializer가 uninit 필드를 덮어쓰기 전에 확인)
+		if (page->uninit.type & VM_ZERO)
+			memset(frame->kva, 0, PGSIZE);
 		break;
 
 	case VM_ANON:
@@ -267,9 +953,23 @@ static bool vm_do_claim_page(struct page *page)
 
 	// 4. swap_in()을 통해 실제 데이터를 프레임에 적재
 	//    - UNINIT이면 lazy initializer 호출
+	//      새 프레임과 이 프로세스의 UNINIT 페이지는 아직 아무도 공유하지 않으므로
+	//      초기화와 파일 읽기를 모두 frame_lock 없이 수행
 	//    - ANON이면 swap 디스크에서 복구
 	//    - FILE이면 mmap된 파일에서 복구
-	return swap_in(page, frame->kva);
+	//      (둘 다 공유 페이지 목록은 락을 잡고 옮기고, 디스크 읽기 동안에만 락을 놓음)
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+	{
+		vm_frame_io_begin(frame);
+		success = swap_in(page, frame->kva);
+		vm_frame_io_end(frame);
+	}
+	else
+		success = swap_in(page, frame->kva);
+
+	// 5. 로딩이 끝났으므로 교체 대상에 다시 포함
+	frame_unpin(frame);
+	return success;
 }
 
 /* 보조 페이지 테이블 초기화 (해시 테이블 구성) */
@@ -284,7 +984,7 @@ void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED)
  * - process_fork() 호출 시 부모의 SPT를 자식에게 복제
  * - 페이지 타입별로 복제 방식이 다름
  *   - UNINIT: aux 구조체 deep copy 후 lazy initializer 복제
- *   - ANON: 물리 메모리에 존재하는 내용까지 복사
+ *   - ANON: 프레임을 읽기 전용으로 공유 (copy-on-write, 첫 쓰기 때 복사)
  *   - FILE: mmap된 파일은 공유하지만 page 구조체는 별도 할당
  *
  * @param dst 자식 프로세스의 보조 페이지 테이블
@@ -296,10 +996,6 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct su
 	struct hash_iterator i;
 	hash_first(&i, &src->spt_hash);
 
-	// 파일 시스템 관련 페이지가 포함될 수 있으므로 락 획득
-	bool is_lock_held = lock_held_by_current_thread(&filesys_lock);
-	if (!is_lock_held) lock_acquire(&filesys_lock);
-
 	while (hash_next(&i))
 	{
 		struct page *page = hash_entry(hash_cur(&i), struct page, page_elem);
@@ -311,8 +1007,26 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct su
 		case VM_UNINIT:
 			// Lazy loading 방식의 페이지
 			// → aux 복사해서 자식도 동일한 방식으로 초기화되게 함
-			aux = malloc(sizeof(struct load));
-			memcpy(aux, page->uninit.aux, sizeof(struct load));
+			if (VM_TYPE(page->uninit.type) == VM_FILE)
+			{
+				// mmap 페이지는 파일 참조를 각자 닫으므로 자식용으로 다시 열고,
+				// 실행 파일 세그먼트 페이지는 자식의 실행 파일을 빌려 씀 (__do_fork에서 복제)
+				struct file_load *load;
+				aux = load = malloc(sizeof(struct file_load));
+				memcpy(load, page->uninit.aux, sizeof(struct file_load));
+				load->file = (page->uninit.type & VM_MMAP) ? file_reopen(load->file)
+														   : thread_current()->running;
+			}
+			else if (page->uninit.aux != NULL)
+			{
+				// 쓰기 가능한 세그먼트 페이지도 부모가 먼저 끝나 닫을 수 있는 부모의 실행 파일 대신
+				// 자식의 실행 파일에서 읽음
+				aux = malloc(sizeof(struct load));
+				memcpy(aux, page->uninit.aux, sizeof(struct load));
+				((struct load *)aux)->file = thread_current()->running;
+			}
+			else
+				aux = NULL;
 
 			vm_alloc_page_with_initializer(
 				page->uninit.type,
@@ -323,19 +1037,20 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct su
 			break;
 
 		case VM_ANON:
-			// 익명 페이지는 실제 물리 메모리에 존재하므로 바로 복제 필요
-			vm_alloc_page_with_initializer(
-				page->operations->type,
-				page->va,
-				page->writable,
-				NULL, NULL);
-
-			// 페이지 확보 (claim)
-			vm_claim_page(page->va);
+			// 익명 페이지는 copy-on-write로 공유
+			// → 자식은 부모와 같은 프레임(또는 스왑 슬롯)을 가리키고 첫 쓰기 때 복사됨
+			newpage = calloc(1, sizeof(struct page));
+			newpage->operations = page->operations;
+			newpage->va = page->va;
+			newpage->writable = page->writable;
+			newpage->pml4 = thread_current()->pml4;
+			spt_insert_page(dst, newpage);
 
-			// 복제한 자식의 페이지 가져와서 물리 메모리 내용 복사
-			newpage = spt_find_page(dst, page->va);
-			memcpy(newpage->frame->kva, page->frame->kva, PGSIZE);
+			// 부모 페이지가 다른 프로세스의 교체로 내보내지는 중이면 끝난 뒤 공유
+			lock_acquire(&frame_lock);
+			vm_frame_wait(page);
+			anon_share_page(newpage, page);
+			lock_release(&frame_lock);
 			break;
 
 		case VM_FILE:
@@ -346,27 +1061,39 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct su
 			newpage->va = page->va;
 			newpage->writable = page->writable;
 			newpage->operations = page->operations;
+			newpage->pml4 = thread_current()->pml4;
 
 			spt_insert_page(dst, newpage);
 
-			// 기존 프레임 공유 (참조 수 증가)
-			newpage->frame = page->frame;
-			newpage->frame->cnt_page++;
-
-			// 파일 정보 복사 (파일은 duplicate해서 사용)
-			newpage->file.file = file_duplicate(page->file.file);
+			// 파일 정보 복사 (mmap 파일은 duplicate해서 사용, 실행 파일 세그먼트는 자식의 실행 파일)
+			newpage->file.file = page->file.mmap ? file_duplicate(page->file.file)
+												 : thread_current()->running;
+			newpage->file.mmap = page->file.mmap;
 			newpage->file.file_length = page->file.file_length;
 			newpage->file.ofs = page->file.ofs;
 			newpage->file.read_bytes = page->file.read_bytes;
 			newpage->file.zero_bytes = page->file.zero_bytes;
+			newpage->file.file_list = NULL;
+
+			lock_acquire(&frame_lock);
+			vm_frame_wait(page);
+
+			// 부모 페이지가 쫓겨난 상태라면 먼저 다시 올려둠
+			if (page->frame == NULL)
+				vm_do_claim_page(page);
+
+			// 기존 프레임 공유 (참조 수 증가, 교체 시 함께 내려가도록 page_list에 등록)
+			newpage->frame = page->frame;
+			newpage->frame->cnt_page++;
+			list_push_back(&newpage->frame->page_list, &newpage->out_elem);
 
 			// MMU에 페이지 등록 (물리 메모리 공유)
 			pml4_set_page(thread_current()->pml4, newpage->va, page->frame->kva, page->writable);
+			lock_release(&frame_lock);
 			break;
 		}
 	}
 
-	if (!is_lock_held) lock_release(&filesys_lock);
 	return true;
 }
 
@@ -388,9 +1115,14 @@ bool vm_claim_page(void *va UNUSED)
 {
 	struct thread *curr = thread_current();
 	struct page *page = spt_find_page(&curr->spt, va);
+	bool success;
+
 	if (page == NULL)
 		PANIC("TODO");
-	return vm_do_claim_page(page);
+	lock_acquire(&frame_lock);
+	success = vm_do_claim_page(page);
+	lock_release(&frame_lock);
+	return success;
 }
 
 /* MMU에 가상주소→물리주소 매핑 */
@@ -400,6 +1132,26 @@ static bool install_page(void *upage, void *kpage, bool writable)
 	return (pml4_get_page(t->pml4, upage) == NULL && pml4_set_page(t->pml4, upage, kpage, writable));
 }
 
+/* 실행 파일 페이지 캐시용 해시 함수: (inode, 오프셋, 읽을 바이트 수) 기반 */
+static uint64_t text_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	struct frame *frame = hash_entry(e, struct frame, text_elem);
+	return hash_bytes(&frame->text_inode, sizeof frame->text_inode) ^ hash_int(frame->text_ofs) ^ hash_int(frame->text_read_bytes);
+}
+
+/* 실행 파일 페이지 캐시용 비교 함수 */
+static bool text_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED)
+{
+	struct frame *a = hash_entry(a_, struct frame, text_elem);
+	struct frame *b = hash_entry(b_, struct frame, text_elem);
+
+	if (a->text_inode != b->text_inode)
+		return a->text_inode < b->text_inode;
+	if (a->text_ofs != b->text_ofs)
+		return a->text_ofs < b->text_ofs;
+	return a->text_read_bytes < b->text_read_bytes;
+}
+
 /* 해시 테이블 정렬용 비교 함수 (va 주소 비교) */
 bool hash_page_less(const struct hash_elem *a, const struct hash_elem *b, void *aux)
 {